@@ -0,0 +1,2 @@
+#pragma once
+// host simulace: vše potřebné je v Adafruit_SSD1306.h
@@ -0,0 +1,92 @@
+#pragma once
+// SSD1306 128x64 bez displeje: framebuffer v RAM + textová mřížka 21x10
+// (font 6x8, řádek po 7 px – glyf 5x7 se dá skládat i bez mezery, viz
+// mřížka bran v UiOled), aby replay mohl vypsat obrazovku a UiOled viděl
+// změny stránek.
+#include <Arduino.h>
+#include <Wire.h>
+
+#define SSD1306_SWITCHCAPVCC 0x02
+#define SSD1306_BLACK        0
+#define SSD1306_WHITE        1
+#define SSD1306_DISPLAYOFF   0xAE
+#define SSD1306_DISPLAYON    0xAF
+
+class Adafruit_SSD1306 : public Print {
+public:
+  static const uint8_t COLS = 21;
+  static const uint8_t ROWS = 10;
+
+  Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* wire, int8_t rst,
+                   uint32_t clkDuring = 400000UL, uint32_t clkAfter = 100000UL)
+    : _w(w), _h(h) { (void)wire; (void)rst; (void)clkDuring; (void)clkAfter; clearDisplay(); instance = this; }
+
+  bool begin(uint8_t vcs, uint8_t addr, bool reset = true, bool periphBegin = true) {
+    (void)vcs; (void)addr; (void)reset; (void)periphBegin;
+    return true;
+  }
+
+  void clearDisplay() {
+    memset(_fb, 0, sizeof(_fb));
+    memset(_text, ' ', sizeof(_text));
+    _cx = _cy = 0;
+  }
+  void display() { frames++; }
+  void ssd1306_command(uint8_t c) { if (c == SSD1306_DISPLAYOFF) on = false; if (c == SSD1306_DISPLAYON) on = true; }
+
+  void setTextSize(uint8_t s) { _size = s ? s : 1; }
+  void setTextColor(uint16_t c) { (void)c; }
+  void setTextColor(uint16_t c, uint16_t bg) { (void)c; (void)bg; }
+  void setCursor(int16_t x, int16_t y) { _cx = x; _cy = y; }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t c) {
+    if (x < 0 || y < 0 || x >= _w || y >= _h) return;
+    uint8_t& b = _fb[(y / 8) * 128 + x];
+    if (c) b |= (uint8_t)(1 << (y & 7)); else b &= (uint8_t)~(1 << (y & 7));
+  }
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t c) { for (int16_t i = 0; i < w; i++) drawPixel(x + i, y, c); }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t c) {
+    for (int16_t j = 0; j < h; j++) drawFastHLine(x, y + j, w, c);
+  }
+
+  int16_t width() const { return _w; }
+  int16_t height() const { return _h; }
+  uint8_t* getBuffer() { return _fb; }
+
+  // znak => textová mřížka + "otisk" 6 sloupců ve framebufferu
+  size_t write(uint8_t c) override {
+    if (c == '\n') { _cx = 0; _cy += 8 * _size; return 1; }
+    if (c == '\r') return 1;
+    const int16_t col = _cx / 6, row = _cy / 7, page = _cy / 8;
+    if (col >= 0 && col < COLS && row >= 0 && row < ROWS) {
+      _text[row][col] = (char)c;
+      for (uint8_t i = 0; i < 6 * _size && _cx + i < 128; i++) _fb[page * 128 + _cx + i] = (uint8_t)(c + i);
+    }
+    _cx += 6 * _size;
+    return 1;
+  }
+  using Print::write;
+
+  // řádek textu (bez koncových mezer)
+  const char* textRow(uint8_t row) {
+    static char line[COLS + 1];
+    memcpy(line, _text[row], COLS);
+    int8_t n = COLS;
+    while (n > 0 && line[n - 1] == ' ') n--;
+    line[n] = 0;
+    return line;
+  }
+
+  // poslední vytvořený displej (UiOled ho má static)
+  static Adafruit_SSD1306* instance;
+
+  uint32_t frames = 0;
+  bool on = true;
+
+private:
+  uint8_t _w, _h;
+  uint8_t _size = 1;
+  int16_t _cx = 0, _cy = 0;
+  uint8_t _fb[128 * 64 / 8];
+  char _text[ROWS][COLS];
+};
@@ -0,0 +1,104 @@
+#pragma once
+// Arduino HAL pro host simulaci (env:native). Jen to, co firmware opravdu
+// používá; čas je virtuální (SimClock), piny a ADC v RAM.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+#define INPUT_ANALOG 0x3
+
+#define CHANGE  2
+#define FALLING 3
+#define RISING  4
+
+// číslování jako STM32duino (PAx = x, PBx = 16 + x, PC13 = 45)
+enum {
+  PA0 = 0, PA1, PA2, PA3, PA4, PA5, PA6, PA7, PA8, PA9, PA10, PA11, PA12, PA13, PA14, PA15,
+  PB0, PB1, PB2, PB3, PB4, PB5, PB6, PB7, PB8, PB9, PB10, PB11, PB12, PB13, PB14, PB15,
+  PC13 = 45, PC14, PC15
+};
+static const uint8_t SIM_PIN_COUNT = 48;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t val);
+int digitalRead(uint32_t pin);
+uint32_t analogRead(uint32_t pin);
+
+void attachInterrupt(uint32_t pin, void (*fn)(void), uint32_t mode);
+void detachInterrupt(uint32_t pin);
+#define digitalPinToInterrupt(p) (p)
+
+// jednovláknová simulace: "ISR" běží jen uvnitř delay()/SimClock::advance()
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t n);
+  virtual int availableForWrite() { return 0; }
+
+  size_t print(const char* s);
+  size_t print(char c);
+  size_t print(int v) { return print((long)v); }
+  size_t print(unsigned v) { return print((unsigned long)v); }
+  size_t print(long v);
+  size_t print(unsigned long v);
+  size_t print(double v, int digits = 2);
+
+  size_t println() { return print("\r\n"); }
+  template <class T> size_t println(T v) { size_t n = print(v); return n + println(); }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int peek() { return -1; }
+  virtual void flush() {}
+};
+
+// Serial -> stdout (vypnutelné přes SimHal::quiet, jinam přes SimHal::serialOut)
+class HardwareSerial : public Stream {
+public:
+  void begin(uint32_t) {}
+  void end() {}
+  int availableForWrite() override { return 256; }
+  size_t write(uint8_t c) override;
+  using Print::write;
+  operator bool() const { return true; }
+
+  int available() override { simPoll(); return (int)(uint8_t)(_rxHead - _rxTail); }
+  int read() override { simPoll(); return _rxHead == _rxTail ? -1 : _rx[_rxTail++]; }
+  int peek() override { simPoll(); return _rxHead == _rxTail ? -1 : _rx[_rxTail]; }
+
+  // simulace: text "přijatý" z linky
+  void simFeed(const char* s) { while (*s) _rx[_rxHead++] = (uint8_t)*s++; }
+  // simulace: linka na deskriptor (pty, SimHal::busOpen) místo stdout
+  void simAttachFd(int fd) { _fd = fd; }
+
+private:
+  uint8_t _rx[256];
+  uint8_t _rxHead = 0, _rxTail = 0;
+  int _fd = -1;
+
+  void simPoll();
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
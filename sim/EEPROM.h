@@ -0,0 +1,35 @@
+#pragma once
+// Emulace EEPROM v RAM (smazaná = 0xFF), API jako STM32duino EEPROM.
+#include <Arduino.h>
+
+class EEPROMClass {
+public:
+  static const uint16_t SIZE = 1024;
+
+  void begin() {}
+  uint16_t length() const { return SIZE; }
+  uint8_t read(int addr) const { return (addr >= 0 && addr < SIZE) ? _mem[addr] : 0xFF; }
+  void write(int addr, uint8_t v) { if (addr >= 0 && addr < SIZE) _mem[addr] = v; }
+  void update(int addr, uint8_t v) { write(addr, v); }
+
+  template <class T> T& get(int addr, T& t) const {
+    uint8_t* p = (uint8_t*)&t;
+    for (size_t i = 0; i < sizeof(T); i++) p[i] = read(addr + (int)i);
+    return t;
+  }
+  template <class T> const T& put(int addr, const T& t) {
+    const uint8_t* p = (const uint8_t*)&t;
+    for (size_t i = 0; i < sizeof(T); i++) write(addr + (int)i, p[i]);
+    return t;
+  }
+
+  // simulace: celá paměť smazaná
+  void erase() { memset(_mem, 0xFF, SIZE); }
+
+  EEPROMClass() { erase(); }
+
+private:
+  uint8_t _mem[SIZE];
+};
+
+extern EEPROMClass EEPROM;
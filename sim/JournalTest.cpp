@@ -0,0 +1,104 @@
+#include "JournalTest.h"
+#include <stdio.h>
+#include "CounterJournal.h"
+#include "FlashIo.h"
+
+namespace {
+
+const uint8_t GATES = 3;
+const uint16_t PAGE = 64;   // hlavička + 7 slotů => kompaktace každých pár zápisů
+const uint8_t OPS = 24;     // zápisů před výpadkem
+const uint8_t OPS_AFTER = 10; // přes další kompaktaci
+
+// flash, která po `budget` operacích (půlslovo / mazání) přestane zapisovat
+class FlashCut : public FlashIo {
+public:
+  FlashRam<2, PAGE> ram;
+  int32_t budget = -1; // -1 = bez výpadku
+
+  uint16_t pageSize() const override { return ram.pageSize(); }
+  uint8_t pageCount() const override { return ram.pageCount(); }
+  uint16_t read16(uint8_t page, uint16_t off) const override { return ram.read16(page, off); }
+  bool program16(uint8_t page, uint16_t off, uint16_t v) override {
+    return step() && ram.program16(page, off, v);
+  }
+  bool erase(uint8_t page) override { return step() && ram.erase(page); }
+
+  bool cut() const { return budget == 0; }
+
+private:
+  bool step() {
+    if (budget == 0) return false;
+    if (budget > 0) budget--;
+    return true;
+  }
+};
+
+// zápis jako Storage: snapshot po změně jedné brány
+bool write(CounterJournal& j, uint32_t counts[], uint8_t gate) {
+  counts[gate]++;
+  return j.append(gate, counts[gate], counts, GATES);
+}
+
+bool same(const uint32_t a[], const uint32_t b[]) {
+  for (uint8_t i = 0; i < GATES; i++) if (a[i] != b[i]) return false;
+  return true;
+}
+
+void print(const char* what, const uint32_t c[]) {
+  printf("%s %lu/%lu/%lu", what, (unsigned long)c[0], (unsigned long)c[1], (unsigned long)c[2]);
+}
+
+} // namespace
+
+int journalTest(bool verbose) {
+  int fails = 0;
+  int32_t cutAt = 0;
+  for (;; cutAt++) {
+    FlashCut flash;
+    CounterJournal j;
+    uint32_t model[GATES] = {0};
+    j.begin(flash, model, GATES);
+    j.compact(model, GATES);
+
+    // zápisy až do výpadku; before = poslední dokončený stav
+    flash.budget = cutAt;
+    uint32_t before[GATES] = {0}, torn[GATES] = {0};
+    bool wasCut = false;
+    for (uint8_t k = 0; k < OPS && !wasCut; k++) {
+      memcpy(before, model, sizeof(model));
+      write(j, model, (uint8_t)((k * 7) % GATES));
+      wasCut = flash.cut();
+    }
+    if (!wasCut) break; // všechny zápisy prošly => všechny body výpadku otestované
+    memcpy(torn, model, sizeof(model));
+
+    // reboot: roztržený zápis buď platí celý, nebo vůbec
+    flash.budget = -1;
+    uint32_t got[GATES];
+    CounterJournal j2;
+    bool ok = j2.begin(flash, got, GATES) && (same(got, before) || same(got, torn));
+
+    // pokračování po rebootu; po každém zápisu další reboot => přesně model
+    memcpy(model, got, sizeof(model));
+    uint32_t got2[GATES] = {0};
+    for (uint8_t k = 0; k < OPS_AFTER && ok; k++) {
+      write(j2, model, (uint8_t)(k % GATES));
+      CounterJournal j3;
+      ok = j3.begin(flash, got2, GATES) && same(got2, model);
+    }
+
+    if (!ok || verbose) {
+      printf("%s vypadek po %ld zapisech: ", ok ? "OK  " : "FAIL", (long)cutAt);
+      print("pred", before);
+      print(", roztrzeny", torn);
+      print(", po rebootu", got);
+      print(", model", model);
+      print(", po 2. rebootu", got2);
+      printf("\n");
+    }
+    if (!ok) fails++;
+  }
+  printf("zurnal: %ld bodu vypadku, %d chyb\n", (long)cutAt, fails);
+  return fails;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <stdint.h>
+
+// Výpadek napájení uprostřed zápisu do CounterJournal: běh se utne po
+// každém možném počtu programovaných půlslov / mazání (záznamy, kompaktace
+// i její hlavička), pak "reboot" (nový begin()) a pokračování. Přehrané
+// počty se porovnávají s modelem. Vrací počet chyb.
+int journalTest(bool verbose);
@@ -0,0 +1,327 @@
+#include "Replay.h"
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <Wire.h>
+#include <Adafruit_SSD1306.h>
+#include "SimClock.h"
+#include "SimHal.h"
+#include "SimApp.h"
+
+static const uint16_t PRESS_DOWN_MS = 80;
+static const uint16_t PRESS_STEP_MS = 200;
+static const uint32_t TAIL_MS = 1000;
+#if MUX_ENABLE
+static const float MUX_ERR_MAX_LSB = 1.0f; // 12 bit, pod šumem jednoho vzorku
+#endif
+
+static uint8_t btnPin(int32_t b) { return b == 2 ? BTN2_PIN : BTN1_PIN; }
+
+Replay::Replay() {
+#if !LOCKIN_ENABLE
+  // bez lock-in 100 Hz zářivka projde decimací (1 ms dávka) => výchozí
+  // scénář bez ní; stopa ji může zapnout přes "sig flicker"
+  _sig.flicker = 0.0f;
+#endif
+}
+
+void Replay::add(uint64_t tMs, Cmd cmd, int32_t a, int32_t b, float f, uint32_t line) {
+  Event e;
+  e.tMs = tMs;
+  e.cmd = cmd;
+  e.a = a;
+  e.b = b;
+  e.f = f;
+  e.line = line;
+  _ev.push_back(e);
+}
+
+// ------------------------------------------------------------
+// Stopa ze souboru
+// ------------------------------------------------------------
+bool Replay::loadTrace(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f) { fprintf(stderr, "%s: nelze otevrit\n", path); return false; }
+
+  char buf[256];
+  uint32_t line = 0;
+  uint64_t t = 0;
+  bool ok = true;
+
+  while (fgets(buf, sizeof(buf), f)) {
+    line++;
+    char* hash = strchr(buf, '#');
+    if (hash) *hash = 0;
+
+    char ts[32], cmd[32], a1[32] = "", a2[32] = "", a3[32] = "";
+    int n = sscanf(buf, "%31s %31s %31s %31s %31s", ts, cmd, a1, a2, a3);
+    if (n <= 0) continue;
+    if (n < 2) { fprintf(stderr, "%s:%u: chybi prikaz\n", path, line); ok = false; continue; }
+
+    t = (ts[0] == '+') ? t + strtoull(ts + 1, nullptr, 10) : strtoull(ts, nullptr, 10);
+    const int32_t i1 = atoi(a1), i2 = atoi(a2);
+
+    if (!strcmp(cmd, "press")) {
+      const int32_t count = n >= 4 ? i2 : 1;
+      for (int32_t k = 0; k < count; k++) {
+        add(t + (uint64_t)k * PRESS_STEP_MS, Cmd::Btn, i1, 1, 0, line);
+        add(t + (uint64_t)k * PRESS_STEP_MS + PRESS_DOWN_MS, Cmd::Btn, i1, 0, 0, line);
+      }
+    } else if (!strcmp(cmd, "hold")) {
+      add(t, Cmd::Btn, i1, 1, 0, line);
+      add(t + (uint64_t)i2, Cmd::Btn, i1, 0, 0, line);
+    } else if (!strcmp(cmd, "btn")) {
+      add(t, Cmd::Btn, i1, i2, 0, line);
+    } else if (!strcmp(cmd, "break") || !strcmp(cmd, "restore")) {
+      add(t, Cmd::Break, i1 - 1, cmd[0] == 'b', 0, line);
+    } else if (!strcmp(cmd, "adc")) {
+      add(t, Cmd::Adc, i1 - 1, a2[0] == '-' ? -1 : i2, 0, line);
+    } else if (!strcmp(cmd, "sig")) {
+      static const char* const PARAMS[] = { "sun", "flicker", "drift", "beam", "noise", "dc" };
+      int32_t p = -1;
+      for (int32_t k = 0; k < 6; k++) if (!strcmp(a1, PARAMS[k])) p = k;
+      if (p < 0) { fprintf(stderr, "%s:%u: neznamy parametr %s\n", path, line, a1); ok = false; continue; }
+      add(t, Cmd::Sig, p, 0, (float)atof(a2), line);
+    } else if (!strcmp(cmd, "expect")) {
+      const int32_t v3 = atoi(a3);
+      if (!strcmp(a1, "count")) add(t, Cmd::ExpCount, i2 - 1, v3, 0, line);
+      else if (!strcmp(a1, "stage")) add(t, Cmd::ExpStage, i2, 0, 0, line);
+      else if (!strcmp(a1, "mode")) add(t, Cmd::ExpMode, !strcmp(a2, "diag") ? 1 : 0, 0, 0, line);
+      else if (!strcmp(a1, "armed")) add(t, Cmd::ExpArmed, i2, 0, 0, line);
+      else if (!strcmp(a1, "tone")) add(t, Cmd::ExpTone, i2, 0, 0, line);
+      else if (!strcmp(a1, "hz")) add(t, Cmd::ExpHz, i2, v3, 0, line);
+      else if (!strcmp(a1, "log")) add(t, Cmd::ExpLog, i2, 0, 0, line);
+      else if (!strcmp(a1, "oled")) add(t, Cmd::ExpOled, i2, 0, 0, line);
+      else if (!strcmp(a1, "rate")) add(t, Cmd::ExpRate, i2, 0, 0, line);
+      else if (!strcmp(a1, "cal")) add(t, Cmd::ExpCal, i2 - 1, v3, 0, line);
+#if BUS_ENABLE
+      else if (!strcmp(a1, "buscount")) add(t, Cmd::ExpBusCount, i2 - 1, v3, 0, line);
+      else if (!strcmp(a1, "busstage")) add(t, Cmd::ExpBusStage, i2, 0, 0, line);
+      else if (!strcmp(a1, "busonline")) add(t, Cmd::ExpBusOnline, i2, 0, 0, line);
+      else if (!strcmp(a1, "buslat")) add(t, Cmd::ExpBusLat, i2, 0, 0, line);
+#endif
+      else { fprintf(stderr, "%s:%u: neznamy expect %s\n", path, line, a1); ok = false; }
+    } else if (!strcmp(cmd, "serial")) {
+      // zbytek řádku za příkazem
+      char* rest = strstr(buf, "serial") + 6;
+      while (*rest == ' ' || *rest == '\t') rest++;
+      std::string text(rest);
+      while (!text.empty() && (text.back() == '\n' || text.back() == '\r' || text.back() == ' ')) text.pop_back();
+      _text.push_back(text + "\n");
+      add(t, Cmd::Serial, (int32_t)_text.size() - 1, 0, 0, line);
+    } else if (!strcmp(cmd, "screen")) {
+      add(t, Cmd::Screen, 0, 0, 0, line);
+    } else if (!strcmp(cmd, "end")) {
+      add(t, Cmd::End, 0, 0, 0, line);
+    } else {
+      fprintf(stderr, "%s:%u: neznamy prikaz %s\n", path, line, cmd);
+      ok = false;
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+// ------------------------------------------------------------
+// Syntetická stopa
+// ------------------------------------------------------------
+void Replay::synth(double hours, uint32_t seed) {
+  uint32_t r = seed ? seed : 1;
+  auto rnd = [&r](uint32_t lo, uint32_t hi) {
+    r ^= r << 13; r ^= r >> 17; r ^= r << 5; // xorshift32
+    return lo + r % (hi - lo + 1);
+  };
+
+  const uint64_t endMs = (uint64_t)(hours * 3600000.0);
+  const uint64_t startMs = 500 + PRESS_DOWN_MS + ARM_IGNORE_MS + 500;
+
+  // ARM
+  add(500, Cmd::Btn, 1, 1);
+  add(500 + PRESS_DOWN_MS, Cmd::Btn, 1, 0);
+
+  for (uint8_t g = 0; g < GATE_COUNT; g++) {
+    uint32_t counted = 0;
+    uint64_t t = startMs + rnd(0, 5000);
+    for (;;) {
+      // 3/4 krátká (nepočítá se), 1/4 přes COUNT_AT_MS s rezervou na obě strany
+      const uint32_t dur = rnd(0, 3) ? rnd(50, COUNT_AT_MS - 500) : rnd(COUNT_AT_MS + 300, 3 * COUNT_AT_MS);
+      if (t + dur + 2000 > endMs) break;
+      add(t, Cmd::Break, g, 1);
+      add(t + dur, Cmd::Break, g, 0);
+      if (dur >= COUNT_AT_MS) counted++;
+      // po dlouhém přerušení se baseline vrací několik s (posun 1/1024 během přerušení)
+      t += dur + rnd(20000, 90000);
+    }
+    add(endMs + TAIL_MS, Cmd::ExpCount, g, (int32_t)counted);
+  }
+  add(endMs + TAIL_MS, Cmd::ExpStage, 0);
+  add(endMs + TAIL_MS, Cmd::End);
+}
+
+// ------------------------------------------------------------
+// Běh
+// ------------------------------------------------------------
+void Replay::onTick(void* ctx) {
+  Replay* self = (Replay*)ctx;
+  simBuzzerAdvance(1000000UL / SAMPLE_HZ);
+  // úsporný režim: TIM3 pomaleji => dávka jen každý rateDiv-tý tick
+  AdcScan& adc = simAdc();
+  if (++self->_tickSkip < adc.rateDiv()) { self->_sig.skipBatch(); return; }
+  self->_tickSkip = 0;
+  self->_sig.feedBatch(adc);
+}
+
+void Replay::expect(const Event& e, const char* what, int32_t want, int32_t is) {
+  if (want == is) return;
+  _fails++;
+  if (e.line) printf("FAIL t=%llu ms (radek %u): %s = %d, ocekavano %d\n", (unsigned long long)e.tMs, e.line, what, is, want);
+  else printf("FAIL t=%llu ms: %s = %d, ocekavano %d\n", (unsigned long long)e.tMs, what, is, want);
+}
+
+void Replay::printScreen() {
+  Adafruit_SSD1306* d = Adafruit_SSD1306::instance;
+  if (!d) return;
+  printf("+---------------------+ t=%lu ms\n", (unsigned long)millis());
+  for (uint8_t r = 0; r < Adafruit_SSD1306::ROWS; r++) {
+    const char* row = d->textRow(r);
+    if (*row) printf("|%-21s|\n", row); // prázdné řádky mřížky po 7 px vynechat
+  }
+  printf("+---------------------+\n");
+}
+
+void Replay::apply(const Event& e) {
+  char what[32];
+  switch (e.cmd) {
+    case Cmd::Btn:
+      SimHal::setInput(btnPin(e.a), e.b ? LOW : HIGH); // active LOW
+      break;
+    case Cmd::Break:
+      _sig.breakBeam((uint8_t)e.a, e.b != 0);
+      break;
+    case Cmd::Adc:
+      _sig.setRaw((uint8_t)e.a, (int16_t)e.b);
+      break;
+    case Cmd::Sig: {
+      float* const p[] = { &_sig.sun, &_sig.flicker, &_sig.drift, &_sig.beam, &_sig.noise, &_sig.dc };
+      *p[e.a] = e.f;
+      break;
+    }
+    case Cmd::ExpCount:
+      snprintf(what, sizeof(what), "count B%d", (int)e.a + 1);
+      expect(e, what, e.b, (int32_t)simGateCount((uint8_t)e.a));
+      break;
+    case Cmd::ExpStage:
+      expect(e, "stage", e.a, simSampler().worstStage());
+      break;
+    case Cmd::ExpMode:
+      expect(e, "mode", e.a, simMode());
+      break;
+    case Cmd::ExpArmed:
+      expect(e, "armed", e.a, simSampler().isArmed() ? 1 : 0);
+      break;
+    case Cmd::ExpTone:
+      expect(e, "tone", e.a, simBuzzerHz() ? 1 : 0);
+      break;
+    case Cmd::ExpHz: {
+      // v mezích => OK, jinak hlášení s hranicí, kterou překročil
+      const int32_t hz = simBuzzerHz();
+      expect(e, "hz", hz < e.a ? e.a : hz > e.b ? e.b : hz, hz);
+    } break;
+    case Cmd::ExpLog:
+      expect(e, "log", e.a, (int32_t)simLogCount());
+      break;
+    case Cmd::ExpOled:
+      expect(e, "oled", e.a, Adafruit_SSD1306::instance && Adafruit_SSD1306::instance->on ? 1 : 0);
+      break;
+    case Cmd::ExpRate:
+      expect(e, "rate", e.a, simSampler().rateDiv());
+      break;
+    case Cmd::ExpCal:
+      snprintf(what, sizeof(what), "cal B%d", (int)e.a + 1);
+      expect(e, what, e.b, simSampler().bank().isCalibrated((uint8_t)e.a) ? 1 : 0);
+      break;
+#if BUS_ENABLE
+    case Cmd::ExpBusCount:
+      snprintf(what, sizeof(what), "buscount B%d", (int)e.a + 1);
+      expect(e, what, e.b, (int32_t)simBusCount((uint8_t)e.a));
+      break;
+    case Cmd::ExpBusStage:
+      expect(e, "busstage", e.a, simBusStage());
+      break;
+    case Cmd::ExpBusOnline:
+      expect(e, "busonline", e.a, simBusOnline());
+      break;
+    case Cmd::ExpBusLat: {
+      // horní mez, ne rovnost
+      const uint32_t us = simBusLatMaxUs();
+      printf("sbernice: max. latence %lu us\n", (unsigned long)us);
+      if (us > (uint32_t)e.a * 1000UL) expect(e, "buslat [us]", e.a * 1000, (int32_t)us);
+      break;
+    }
+#else
+    case Cmd::ExpBusCount:
+    case Cmd::ExpBusStage:
+    case Cmd::ExpBusOnline:
+    case Cmd::ExpBusLat:
+      break;
+#endif
+    case Cmd::Serial:
+      Serial.simFeed(_text[e.a].c_str());
+      break;
+    case Cmd::Screen:
+      printScreen();
+      break;
+    case Cmd::End:
+      break;
+  }
+}
+
+int Replay::run() {
+  std::stable_sort(_ev.begin(), _ev.end(), [](const Event& x, const Event& y) { return x.tMs < y.tMs; });
+
+  uint64_t endMs = _ev.empty() ? TAIL_MS : _ev.back().tMs + TAIL_MS;
+  for (const Event& e : _ev) {
+    if (e.cmd == Cmd::End) { endMs = e.tMs; break; }
+  }
+
+  _sig.fast = fast;
+  SimHal::reset();
+  for (uint8_t in = 0; in < ADC_INPUTS; in++) SimHal::setAnalog(ADC_PINS[in], _sig.level(in * MUX_WAYS));
+
+  const auto wall0 = std::chrono::steady_clock::now();
+
+  setup();
+  SimClock::setTick(1000000UL / SAMPLE_HZ, onTick, this);
+
+  size_t next = 0;
+  while (SimClock::nowUs() / 1000ULL < endMs) {
+    const uint64_t nowMs = SimClock::nowUs() / 1000ULL;
+    while (next < _ev.size() && _ev[next].tMs <= nowMs) apply(_ev[next++]);
+    loop();
+    SimClock::advance(loopUs);
+    if (realtime) std::this_thread::sleep_until(wall0 + std::chrono::microseconds(SimClock::nowUs()));
+  }
+  while (next < _ev.size() && _ev[next].tMs <= endMs) apply(_ev[next++]);
+
+  const double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+  const double simS = (double)SimClock::nowUs() / 1e6;
+
+  printf("sim %.1f s (%.2f h) za %.2f s => %.0fx realny cas\n", simS, simS / 3600.0, wallS, wallS > 0 ? simS / wallS : 0.0);
+  printf("pocty:");
+  for (uint8_t g = 0; g < GATE_COUNT; g++) printf(" B%u=%lu", g + 1, (unsigned long)simGateCount(g));
+  printf("\nzahozene udalosti: %u, I2C prenosy: %lu\n", simSampler().droppedEvents(), (unsigned long)Wire.transfers);
+#if MUX_ENABLE
+  // vzorek mimo svou bránu nebo neustálený COM => plán adres nesedí
+  const MuxModel& mux = _sig.mux();
+  printf("mux: %llu skenu, max. chyba usazeni %.2f LSB, cizi adresa %lu\n",
+         (unsigned long long)mux.scans(), mux.maxErr(), (unsigned long)mux.addrErrors());
+  if (mux.addrErrors() || mux.maxErr() > MUX_ERR_MAX_LSB) {
+    printf("FAIL mux: ustaleni/adresy mimo toleranci %.1f LSB\n", MUX_ERR_MAX_LSB);
+    _fails++;
+  }
+#endif
+  if (showScreen) printScreen();
+  printf("%s (%d chyb)\n", _fails ? "FAIL" : "OK", _fails);
+  return _fails;
+}
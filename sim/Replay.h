@@ -0,0 +1,70 @@
+#pragma once
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "SignalSim.h"
+
+// Přehrání stopy (ADC signál, tlačítka, očekávání) přes skutečný firmware
+// ve virtuálním čase. Jedna stopa = jeden proces (main.cpp má statický stav).
+//
+// Formát stopy (text, '#' komentář), řádek = čas [ms] + příkaz:
+//   <t>|+<dt>  press <1|2> [n]      n krátkých stisků (80 ms, rozestup 200 ms)
+//              hold <1|2> <ms>      dlouhý stisk
+//              btn <1|2> <0|1>      1 = stisknuto
+//              break <g> / restore <g>  paprsek brány g (1..GATE_COUNT)
+//              adc <g> <v12|->      nahraný surový vzorek / zpět model
+//              sig <param> <val>    sun, flicker, drift, beam, noise, dc
+//              expect count <g> <n> | stage <n> | mode run|diag | armed <0|1> | tone <0|1>
+//                     | hz <min> <max> (frekvence piezo) | log <n> (záznamů přerušení)
+//                     | oled <0|1> (displej svítí)
+//                     | rate <div> (vzorkování SAMPLE_HZ/div)
+//                     | cal <g> <0|1> (platná kalibrace ZERO/MAX)
+//                     | buscount <g> <n> | busstage <n> | busonline <n> | buslat <max ms>
+//                       (master sběrnice, BUS_ENABLE; g v globálním číslování)
+//              serial <text...>     řádek do sériové konzole
+//              screen               výpis textu OLED
+//              end                  konec stopy (jinak 1 s po poslední události)
+class Replay {
+public:
+  uint32_t loopUs = 1000;  // virtuální délka jednoho loop()
+  bool showScreen = false; // OLED na konci
+  bool fast = false;       // zjednodušený signál (SignalSim::fast) – řádově rychlejší
+  bool realtime = false;   // čekat na skutečný čas (sběrnice s druhým procesem)
+
+  Replay();
+
+  bool loadTrace(const char* path);
+  // náhodné přerušení všech bran po dobu hours, s očekávanými počty na konci
+  void synth(double hours, uint32_t seed);
+
+  // vrací počet nesplněných expect
+  int run();
+
+private:
+  enum class Cmd : uint8_t { Btn, Break, Adc, Sig, ExpCount, ExpStage, ExpMode, ExpArmed, ExpTone, ExpHz, ExpLog,
+                           ExpOled, ExpRate, ExpCal,
+                           ExpBusCount, ExpBusStage, ExpBusOnline, ExpBusLat, Serial, Screen, End };
+
+  struct Event {
+    uint64_t tMs;
+    Cmd cmd;
+    int32_t a;
+    int32_t b;
+    float f;
+    uint32_t line;
+  };
+
+  std::vector<Event> _ev;
+  std::vector<std::string> _text; // argumenty "serial"
+  SignalSim _sig;
+  int _fails = 0;
+  uint8_t _tickSkip = 0; // ticky vynechané při AdcScan::rateDiv() > 1
+
+  void add(uint64_t tMs, Cmd cmd, int32_t a = 0, int32_t b = 0, float f = 0.0f, uint32_t line = 0);
+  void apply(const Event& e);
+  void expect(const Event& e, const char* what, int32_t want, int32_t is);
+  void printScreen();
+
+  static void onTick(void* ctx);
+};
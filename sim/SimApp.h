@@ -0,0 +1,22 @@
+#pragma once
+#include <Arduino.h>
+#include "AdcScan.h"
+#include "Sampler.h"
+
+// Firmware (src/main.cpp) v host buildu – setup()/loop() a pohled na stav.
+void setup();
+void loop();
+
+AdcScan& simAdc();
+const Sampler& simSampler();
+uint32_t simGateCount(uint8_t g);
+uint8_t simMode();        // AppMode: 0 = RUN, 1 = DIAG
+uint16_t simBuzzerHz();
+void simBuzzerAdvance(uint32_t us); // časovač piezo (siréna, melodie)
+uint32_t simLogCount();   // záznamy přerušení (flash + RAM)
+#if BUS_ENABLE
+uint32_t simBusCount(uint8_t g); // master: globální tabulka (brána slave i = i*GATE_COUNT + g)
+uint8_t simBusStage();           // master: stupeň alarmu vč. slave
+uint8_t simBusOnline();
+uint32_t simBusLatMaxUs();       // max. latence události slave -> master
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+#include <stdint.h>
+
+// Virtuální čas host simulace. millis()/micros() čtou odsud, delay()
+// čas posouvá. Periodický "timer" (ADC dávka) se spouští při každém
+// průchodu svou periodou – jako DMA přerušení během delay() nebo loop().
+namespace SimClock {
+  typedef void (*TickFn)(void* ctx);
+
+  uint64_t nowUs();
+  void reset();
+
+  // posun času; během něj proběhnou všechny ticky, které na něj připadnou
+  void advance(uint32_t us);
+
+  void setTick(uint32_t periodUs, TickFn fn, void* ctx);
+}
@@ -0,0 +1,199 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Wire.h>
+#include <Adafruit_SSD1306.h>
+#include <stdio.h>
+#include "SimClock.h"
+#include "SimHal.h"
+#if SIM_POSIX
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+// ------------------------------------------------------------
+// Virtuální čas
+// ------------------------------------------------------------
+static uint64_t s_nowUs = 0;
+static uint64_t s_nextTickUs = 0;
+static uint32_t s_tickPeriodUs = 0;
+static SimClock::TickFn s_tickFn = nullptr;
+static void* s_tickCtx = nullptr;
+
+uint64_t SimClock::nowUs() { return s_nowUs; }
+
+void SimClock::reset() {
+  s_nowUs = 0;
+  s_nextTickUs = s_tickPeriodUs;
+}
+
+void SimClock::advance(uint32_t us) {
+  const uint64_t target = s_nowUs + us;
+  while (s_tickFn && s_nextTickUs <= target) {
+    s_nowUs = s_nextTickUs;
+    s_nextTickUs += s_tickPeriodUs;
+    s_tickFn(s_tickCtx);
+  }
+  s_nowUs = target;
+}
+
+void SimClock::setTick(uint32_t periodUs, TickFn fn, void* ctx) {
+  s_tickPeriodUs = periodUs;
+  s_tickFn = fn;
+  s_tickCtx = ctx;
+  s_nextTickUs = s_nowUs + periodUs;
+}
+
+uint32_t millis() { return (uint32_t)(s_nowUs / 1000ULL); }
+uint32_t micros() { return (uint32_t)s_nowUs; }
+void delay(uint32_t ms) { SimClock::advance(ms * 1000UL); }
+void delayMicroseconds(uint32_t us) { SimClock::advance(us); }
+
+// ------------------------------------------------------------
+// Piny
+// ------------------------------------------------------------
+static uint8_t s_mode[SIM_PIN_COUNT];
+static uint8_t s_out[SIM_PIN_COUNT];
+static int8_t s_in[SIM_PIN_COUNT];      // -1 = nic nepřipojeno
+static uint16_t s_analog[SIM_PIN_COUNT];
+static void (*s_isr[SIM_PIN_COUNT])(void);  // EXTI (attachInterrupt)
+static uint8_t s_isrMode[SIM_PIN_COUNT];
+
+void SimHal::reset() {
+  for (uint8_t p = 0; p < SIM_PIN_COUNT; p++) {
+    s_mode[p] = INPUT;
+    s_out[p] = LOW;
+    s_in[p] = -1;
+    s_analog[p] = 2048;
+    s_isr[p] = nullptr;
+  }
+  EEPROM.erase();
+  SimClock::reset();
+}
+
+void SimHal::setInput(uint8_t pin, int8_t level) {
+  if (pin >= SIM_PIN_COUNT) return;
+  const int before = digitalRead(pin);
+  s_in[pin] = level;
+  const int after = digitalRead(pin);
+  // EXTI hned při změně vstupu (z replay mezi průchody loop())
+  if (!s_isr[pin] || before == after) return;
+  const uint8_t m = s_isrMode[pin];
+  if (m == CHANGE || (m == RISING && after) || (m == FALLING && !after)) s_isr[pin]();
+}
+void SimHal::setAnalog(uint8_t pin, uint16_t v12) { if (pin < SIM_PIN_COUNT) s_analog[pin] = v12; }
+uint8_t SimHal::output(uint8_t pin) { return pin < SIM_PIN_COUNT ? s_out[pin] : LOW; }
+
+void pinMode(uint32_t pin, uint32_t mode) { if (pin < SIM_PIN_COUNT) s_mode[pin] = (uint8_t)mode; }
+
+void digitalWrite(uint32_t pin, uint32_t val) { if (pin < SIM_PIN_COUNT) s_out[pin] = val ? HIGH : LOW; }
+
+int digitalRead(uint32_t pin) {
+  if (pin >= SIM_PIN_COUNT) return LOW;
+  if (s_mode[pin] == OUTPUT) return s_out[pin];
+  if (s_in[pin] >= 0) return s_in[pin];
+  return s_mode[pin] == INPUT_PULLUP ? HIGH : LOW;
+}
+
+uint32_t analogRead(uint32_t pin) { return pin < SIM_PIN_COUNT ? s_analog[pin] : 0; }
+
+void attachInterrupt(uint32_t pin, void (*fn)(void), uint32_t mode) {
+  if (pin >= SIM_PIN_COUNT) return;
+  s_isr[pin] = fn;
+  s_isrMode[pin] = (uint8_t)mode;
+}
+void detachInterrupt(uint32_t pin) { if (pin < SIM_PIN_COUNT) s_isr[pin] = nullptr; }
+
+// ------------------------------------------------------------
+// Print / Serial
+// ------------------------------------------------------------
+size_t Print::write(const uint8_t* buf, size_t n) {
+  for (size_t i = 0; i < n; i++) write(buf[i]);
+  return n;
+}
+
+size_t Print::print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+
+size_t Print::print(long v) {
+  char b[24];
+  snprintf(b, sizeof(b), "%ld", v);
+  return print(b);
+}
+
+size_t Print::print(unsigned long v) {
+  char b[24];
+  snprintf(b, sizeof(b), "%lu", v);
+  return print(b);
+}
+
+size_t Print::print(double v, int digits) {
+  char b[40];
+  snprintf(b, sizeof(b), "%.*f", digits, v);
+  return print(b);
+}
+
+bool SimHal::quiet = false;
+FILE* SimHal::serialOut = nullptr;
+
+size_t HardwareSerial::write(uint8_t c) {
+#if SIM_POSIX
+  if (_fd >= 0) return ::write(_fd, &c, 1) == 1 ? 1 : 0;
+#endif
+  if (SimHal::serialOut) fputc(c, SimHal::serialOut);
+  else if (!SimHal::quiet) fputc(c, stdout);
+  return 1;
+}
+
+void HardwareSerial::simPoll() {
+#if SIM_POSIX
+  if (_fd < 0) return;
+  uint8_t buf[64];
+  const uint8_t room = (uint8_t)(255 - (uint8_t)(_rxHead - _rxTail));
+  const ssize_t n = ::read(_fd, buf, room < sizeof(buf) ? room : sizeof(buf));
+  for (ssize_t i = 0; i < n; i++) _rx[_rxHead++] = buf[i];
+#endif
+}
+
+// ------------------------------------------------------------
+// Sběrnice řadičů přes pseudoterminál (dva procesy simulace)
+// ------------------------------------------------------------
+#if SIM_POSIX
+static bool rawNonblock(int fd) {
+  struct termios t;
+  if (tcgetattr(fd, &t) == 0) {
+    cfmakeraw(&t); // žádné echo ani úpravy bajtů
+    tcsetattr(fd, TCSANOW, &t);
+  }
+  return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0;
+}
+
+bool SimHal::busCreatePty(char* path, size_t len) {
+  const int fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) return false;
+  const char* name = ptsname(fd);
+  if (!name) return false;
+  snprintf(path, len, "%s", name);
+  // druhý konec držet otevřený (a raw): bez něj by master dostával EIO/hangup
+  const int peer = open(name, O_RDWR | O_NOCTTY);
+  if (peer < 0 || !rawNonblock(peer) || !rawNonblock(fd)) return false;
+  Serial1.simAttachFd(fd);
+  return true;
+}
+
+bool SimHal::busOpen(const char* path) {
+  const int fd = open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0 || !rawNonblock(fd)) return false;
+  Serial1.simAttachFd(fd);
+  return true;
+}
+#else
+bool SimHal::busCreatePty(char*, size_t) { return false; }
+bool SimHal::busOpen(const char*) { return false; }
+#endif
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+EEPROMClass EEPROM;
+TwoWire Wire;
+Adafruit_SSD1306* Adafruit_SSD1306::instance = nullptr;
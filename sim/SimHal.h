@@ -0,0 +1,30 @@
+#pragma once
+#include <Arduino.h>
+#include <stdio.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #define SIM_POSIX 1
+#else
+  #define SIM_POSIX 0
+#endif
+
+// Ovládání HAL shimů z replay enginu (piny "zvenku").
+namespace SimHal {
+  // piny do výchozího stavu, EEPROM smazaná, čas 0
+  void reset();
+
+  // úroveň vstupu (tlačítko); -1 = odpojeno => pull-up/pull-down podle pinMode
+  void setInput(uint8_t pin, int8_t level);
+  void setAnalog(uint8_t pin, uint16_t v12);
+  uint8_t output(uint8_t pin);
+
+  // Serial nevypisuje na stdout
+  extern bool quiet;
+  // kam jde výstup Serial (nullptr = stdout), např. záznam telemetrie
+  extern FILE* serialOut;
+
+  // Serial1 (sběrnice řadičů) na pseudoterminál: vytvořit nový (cestu k
+  // druhému konci vrátí v path) nebo otevřít existující; jen POSIX
+  bool busCreatePty(char* path, size_t len);
+  bool busOpen(const char* path);
+}
@@ -0,0 +1,28 @@
+#pragma once
+// I2C bez sběrnice: přenosy se jen počítají (statistika pro replay).
+#include <Arduino.h>
+
+class TwoWire {
+public:
+  void begin() {}
+  void setClock(uint32_t hz) { clockHz = hz; }
+  void beginTransmission(uint8_t addr) { _addr = addr; _len = 0; }
+  size_t write(uint8_t) { _len++; return 1; }
+  size_t write(const uint8_t*, size_t n) { _len += n; return n; }
+  uint8_t endTransmission(bool stop = true) {
+    (void)stop;
+    transfers++;
+    bytes += _len;
+    return 0;
+  }
+
+  uint32_t clockHz = 100000;
+  uint32_t transfers = 0;
+  uint64_t bytes = 0;
+
+private:
+  uint8_t _addr = 0;
+  size_t _len = 0;
+};
+
+extern TwoWire Wire;
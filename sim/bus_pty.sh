@@ -0,0 +1,25 @@
+#!/bin/sh
+# Sběrnice řadičů bez hardwaru: dva procesy simulace na jednom pseudoterminálu
+# místo RS-485. Master (bus_master.trc) pty vytvoří, slave 1 (bus_slave.trc)
+# se k němu připojí; oba běží v reálném čase.
+#   pio run -e native_bus && sim/bus_pty.sh .pio/build/native_bus/program
+BIN=${1:-.pio/build/native_bus/program}
+DIR=$(dirname "$0")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+"$BIN" "$DIR/traces/bus_master.trc" --bus-pty "$TMP/pty" --realtime --quiet > "$TMP/master.out" 2>&1 &
+MASTER=$!
+while [ ! -s "$TMP/pty" ]; do
+  kill -0 $MASTER 2>/dev/null || { cat "$TMP/master.out"; exit 2; }
+  sleep 0.01
+done
+
+"$BIN" "$DIR/traces/bus_slave.trc" --bus "$(cat "$TMP/pty")" --realtime --quiet > "$TMP/slave.out" 2>&1
+SLAVE_RC=$?
+wait $MASTER
+MASTER_RC=$?
+
+echo "== master"; cat "$TMP/master.out"
+echo "== slave";  cat "$TMP/slave.out"
+[ $MASTER_RC -eq 0 ] && [ $SLAVE_RC -eq 0 ]
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include "Replay.h"
+#include "SimHal.h"
+#include "JournalTest.h"
+
+// Host simulace: firmware + HAL shimy + replay.
+//   program <stopa.trc> [--screen] [--loop-us N]
+//   program --synth <hodiny> [--seed N] [--fast] [--screen]
+//   program --journal-test [-v]: výpadky napájení při zápisu žurnálu počítadel (JournalTest.h)
+//   --serial-out <soubor>: výstup Serial do souboru (záznam telemetrie pro tools/teledec)
+//   --bus-pty <soubor>: Serial1 (sběrnice řadičů) na nový pty, cestu k druhému konci zapíše do souboru
+//   --bus <pty>: Serial1 na existující pty (druhý proces, viz sim/bus_pty.sh)
+//   --realtime: virtuální čas nepředbíhá skutečný (dva procesy na jedné sběrnici)
+// Návratový kód = počet nesplněných expect (0 = OK).
+int main(int argc, char** argv) {
+  Replay rp;
+  const char* trace = nullptr;
+  double hours = 0.0;
+  uint32_t seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    if (!strcmp(a, "--journal-test")) return journalTest(i + 1 < argc && !strcmp(argv[i + 1], "-v")) ? 1 : 0;
+    if (!strcmp(a, "--synth") && i + 1 < argc) hours = atof(argv[++i]);
+    else if (!strcmp(a, "--seed") && i + 1 < argc) seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(a, "--loop-us") && i + 1 < argc) rp.loopUs = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(a, "--screen")) rp.showScreen = true;
+    else if (!strcmp(a, "--fast")) rp.fast = true;
+    else if (!strcmp(a, "--quiet")) SimHal::quiet = true;
+    else if (!strcmp(a, "--serial-out") && i + 1 < argc) {
+      SimHal::serialOut = fopen(argv[++i], "wb");
+      if (!SimHal::serialOut) { perror(argv[i]); return 2; }
+    }
+    else if (!strcmp(a, "--realtime")) rp.realtime = true;
+    else if (!strcmp(a, "--bus") && i + 1 < argc) {
+      if (!SimHal::busOpen(argv[++i])) { perror(argv[i]); return 2; }
+    }
+    else if (!strcmp(a, "--bus-pty") && i + 1 < argc) {
+      char path[64];
+      if (!SimHal::busCreatePty(path, sizeof(path))) { perror("pty"); return 2; }
+      FILE* f = fopen(argv[++i], "w");
+      if (!f) { perror(argv[i]); return 2; }
+      fprintf(f, "%s\n", path);
+      fclose(f);
+    }
+    else if (a[0] != '-') trace = a;
+    else { fprintf(stderr, "neznamy prepinac %s\n", a); return 2; }
+  }
+
+  if (trace) {
+    if (!rp.loadTrace(trace)) return 2;
+  } else if (hours > 0.0) {
+    rp.synth(hours, seed);
+  } else {
+    fprintf(stderr, "pouziti: %s <stopa.trc> | --synth <hodiny> | --journal-test [-v] [--seed N] [--loop-us N] [--fast] [--screen] [--quiet] [--serial-out F] [--bus-pty F | --bus PTY] [--realtime]\n", argv[0]);
+    return 2;
+  }
+  const bool failed = rp.run();
+  if (SimHal::serialOut) fclose(SimHal::serialOut);
+  return failed ? 1 : 0;
+}
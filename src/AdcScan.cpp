@@ -0,0 +1,329 @@
+#include "AdcScan.h"
+#include "Dwt.h"
+#include "Profiler.h"
+#include "MuxScan.h"
+
+// log2(ADC_OVERSAMPLE)
+static constexpr uint8_t log2u(uint32_t v) { return v <= 1 ? 0 : (uint8_t)(1 + log2u(v >> 1)); }
+static const uint8_t OS_SHIFT  = log2u(ADC_OVERSAMPLE);
+static const uint8_t DEC_SHIFT = OS_SHIFT - ADC_EXTRA_BITS;
+
+static_assert((ADC_OVERSAMPLE & (ADC_OVERSAMPLE - 1)) == 0, "ADC_OVERSAMPLE musi byt mocnina 2");
+// mux: jen 4 vzorky na bránu => měřítko 14 bit zůstává (prahy), skutečné rozlišení ~13 bit
+static_assert(MUX_ENABLE || ADC_EXTRA_BITS * 2 <= OS_SHIFT, "na kazdy extra bit je potreba 4x oversampling");
+static_assert(OS_SHIFT >= ADC_EXTRA_BITS, "malo vzorku na ADC_EXTRA_BITS");
+static_assert(ADC_OVERSAMPLE <= 16, "soucet 12bit vzorku se musi vejit do 16 bit");
+
+#if LOCKIN_ENABLE
+static_assert((ADC_OVERSAMPLE & 1) == 0, "lock-in potrebuje sudy pocet skenu na davku");
+#endif
+
+void AdcScan::processHalf(uint8_t half) {
+  PROF_SCOPE(Prof::AdcIsr);
+  const volatile uint16_t* p = &_raw[half ? HALF_LEN : 0];
+
+#if LOCKIN_ENABLE
+  // synchronní demodulace: +ON -OFF po dvojicích skenů. Fáze nosné vůči
+  // začátku dávky není známá (start TIM3) => bereme absolutní hodnotu.
+  int32_t acc[GATE_COUNT] = {0};
+  for (uint8_t s = 0; s < ADC_OVERSAMPLE; s += 2) {
+    for (uint8_t ch = 0; ch < GATE_COUNT; ch++) acc[ch] += (int32_t)p[ch] - (int32_t)p[ch + GATE_COUNT];
+    p += 2 * GATE_COUNT;
+  }
+  // OS/2 dvojic; 14bit měřítko = 4 * sum / (OS/2) = sum >> (OS_SHIFT - 1 - ADC_EXTRA_BITS)
+  for (uint8_t ch = 0; ch < GATE_COUNT; ch++) {
+    int32_t a = acc[ch] < 0 ? -acc[ch] : acc[ch];
+    _dec[ch] = (uint16_t)(a >> (DEC_SHIFT - 1));
+  }
+#else
+  uint16_t acc[GATE_COUNT] = {0};
+
+  // jeden lineární průchod v pořadí DMA; sken s převádí vstupy na adrese
+  // muxu s % MUX_WAYS => brána = vstup*MUX_WAYS + adresa (bez muxu = vstup)
+  for (uint8_t s = 0; s < ADC_OVERSAMPLE; s++) {
+    for (uint8_t a = 0; a < MUX_WAYS; a++) {
+      for (uint8_t in = 0; in < ADC_INPUTS; in++) {
+        uint16_t& x = acc[in * MUX_WAYS + a];
+        x = (uint16_t)(x + *p++);
+      }
+    }
+  }
+  for (uint8_t ch = 0; ch < GATE_COUNT; ch++) _dec[ch] = (uint16_t)(acc[ch] >> DEC_SHIFT);
+#endif
+
+  _batchCycles = dwtCycles();
+  _batches++;
+  if (_onBatch) _onBatch();
+}
+
+bool AdcScan::takeOnset(uint8_t ch, uint32_t& cycles) {
+  const uint32_t bit = 1UL << ch;
+  // test, čtení i smazání naráz => ISR nepřepíše čas mezi nimi
+  noInterrupts();
+  const bool pending = _onsetPending & bit;
+  if (pending) {
+    cycles = _onsetCycles[ch];
+    _onsetPending &= ~bit;
+  }
+  interrupts();
+  return pending;
+}
+
+void AdcScan::beginFake(uint16_t initial) {
+  _fake = true;
+  for (uint8_t i = 0; i < GATE_COUNT; i++) inject(i, initial);
+  processHalf(0);
+}
+
+void AdcScan::inject(uint8_t ch, uint16_t v) {
+  if (ch >= GATE_COUNT) return;
+  const uint8_t in = ch / MUX_WAYS;
+  for (uint16_t s = ch % MUX_WAYS; s < 2 * ADC_SCANS; s += MUX_WAYS) _raw[s * ADC_INPUTS + in] = v;
+}
+
+void AdcScan::injectRaw(uint8_t scan, uint8_t in, uint16_t v) {
+  if (in >= ADC_INPUTS || scan >= ADC_SCANS) return;
+  uint16_t half = (uint16_t)(_batches & 1);
+  _raw[half * HALF_LEN + (uint16_t)scan * ADC_INPUTS + in] = v;
+}
+
+void AdcScan::injectScan(uint8_t scan, const uint16_t v[ADC_INPUTS]) {
+  if (scan >= ADC_SCANS) return;
+  volatile uint16_t* p = &_raw[(uint16_t)(_batches & 1) * HALF_LEN + (uint16_t)scan * ADC_INPUTS];
+  for (uint8_t in = 0; in < ADC_INPUTS; in++) p[in] = v[in];
+}
+
+void AdcScan::fakeDecimated(const uint16_t v14[GATE_COUNT]) {
+  for (uint8_t ch = 0; ch < GATE_COUNT; ch++) _dec[ch] = v14[ch];
+  _batchCycles = dwtCycles();
+  _batches++;
+  if (_onBatch) _onBatch();
+}
+
+void AdcScan::fakeBatch() {
+  const uint8_t half = (uint8_t)(_batches & 1);
+
+#if AWD_ONSET_ENABLE
+  // emulace AWD: první vzorek mimo okno, čas dopočítaný z pozice skenu
+  if (_awdArmed) {
+    const volatile uint16_t* p = &_raw[half * HALF_LEN];
+    const uint32_t scanCycles = (uint32_t)CPU_MHZ * 1000000UL * _rateDiv / ((uint32_t)SAMPLE_HZ * ADC_SCANS);
+    const uint32_t now = dwtCycles();
+    for (uint16_t i = 0; i < HALF_LEN && _awdArmed; i++) {
+      if (p[i] >= _awdLo && p[i] <= _awdHi) continue;
+      const uint8_t ch = (uint8_t)(i % GATE_COUNT);
+      _onsetCycles[ch] = now - (uint32_t)(ADC_OVERSAMPLE - 1 - i / GATE_COUNT) * scanCycles;
+      _onsetPending |= 1UL << ch;
+      _awdArmed = false;
+    }
+  }
+#endif
+
+  processHalf(half);
+}
+
+#if IR_HW_STM32
+
+static AdcScan* s_adc = nullptr;
+static HardwareTimer* s_trig = nullptr;
+#if MUX_ENABLE
+static MuxScan s_mux;
+#endif
+// ADC, které převádí vstupy s indexem i % ADC_PARALLEL (ADC1 = master)
+static ADC_TypeDef* const s_adcs[] = { ADC1, ADC2 };
+
+extern "C" void DMA1_Channel1_IRQHandler(void) {
+  uint32_t isr = DMA1->ISR;
+  if (isr & DMA_ISR_HTIF1) { DMA1->IFCR = DMA_IFCR_CHTIF1; s_adc->processHalf(0); }
+  if (isr & DMA_ISR_TCIF1) { DMA1->IFCR = DMA_IFCR_CTCIF1; s_adc->processHalf(1); }
+  DMA1->IFCR = DMA_IFCR_CGIF1;
+}
+
+extern "C" void ADC1_2_IRQHandler(void) {
+  bool awd = false;
+  for (uint8_t a = 0; a < ADC_PARALLEL; a++) awd |= (s_adcs[a]->SR & ADC_SR_AWD) != 0;
+  if (awd) s_adc->onWatchdog();
+}
+
+void AdcScan::onWatchdog() {
+  const uint32_t now = dwtCycles();
+  // který kanál: DMA už zapsalo vzorek (dual: dvojici), který AWD spustil
+  // => slot = (délka - CNDTR - 1) v kruhovém bufferu, ADC podle SR
+  const uint16_t total = 2 * HALF_LEN / ADC_PARALLEL;
+  uint16_t written = (uint16_t)(total - DMA1_Channel1->CNDTR);
+  uint16_t idx = (uint16_t)((written + total - 1) % total);
+  uint8_t ch = (uint8_t)((idx % ADC_SLOTS) * ADC_PARALLEL);
+  if (ADC_PARALLEL > 1 && !(ADC1->SR & ADC_SR_AWD)) ch++;
+
+  _onsetCycles[ch] = now;
+  _onsetPending |= 1UL << ch;
+
+  // jen první překročení; znovu zapne až další dávka (jinak IRQ bouře,
+  // dokud je brána mimo okno)
+  for (uint8_t a = 0; a < ADC_PARALLEL; a++) {
+    s_adcs[a]->CR1 &= ~ADC_CR1_AWDIE;
+    s_adcs[a]->SR = ~ADC_SR_AWD;
+  }
+  _awdArmed = false;
+}
+
+void AdcScan::setWatchWindow(uint16_t lo12, uint16_t hi12, bool arm) {
+#if !AWD_ONSET_ENABLE
+  (void)lo12; (void)hi12; (void)arm; // modulovaný signál / mux – AWD nedává smysl
+#else
+  if (_fake) { _awdLo = lo12; _awdHi = hi12; _awdArmed = arm; return; }
+  for (uint8_t a = 0; a < ADC_PARALLEL; a++) {
+    ADC_TypeDef* adc = s_adcs[a];
+    adc->CR1 &= ~ADC_CR1_AWDIE;
+    adc->LTR = lo12;
+    adc->HTR = hi12;
+    adc->SR = ~ADC_SR_AWD;
+  }
+  _awdLo = lo12; _awdHi = hi12;
+  _awdArmed = arm;
+  if (arm) {
+    for (uint8_t a = 0; a < ADC_PARALLEL; a++) s_adcs[a]->CR1 |= ADC_CR1_AWDIE;
+  }
+#endif
+}
+
+bool AdcScan::begin() {
+  _fake = false;
+  s_adc = this;
+  dwtBegin();
+
+  RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
+#if DUAL_ADC_ENABLE
+  RCC->APB2ENR |= RCC_APB2ENR_ADC2EN;
+#endif
+  RCC->AHBENR  |= RCC_AHBENR_DMA1EN;
+  // ADC clock = PCLK2/6 = 12 MHz (max 14 MHz)
+  RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_ADCPRE) | RCC_CFGR_ADCPRE_DIV6;
+
+  // --- DMA1 Channel1: ADC1->DR -> _raw, kruhově, IRQ na HT/TC ---
+  // jedno ADC po 16 bitech; dual po 32 bitech: DR = ADC2<<16 | ADC1
+  // => little endian rovnou dvojice vstupů (2j, 2j+1), rozbalovat se nemusí
+  DMA1_Channel1->CCR   = 0;
+  DMA1_Channel1->CPAR  = (uint32_t)&ADC1->DR;
+  DMA1_Channel1->CMAR  = (uint32_t)_raw;
+  DMA1_Channel1->CNDTR = 2 * HALF_LEN / ADC_PARALLEL;
+  DMA1_Channel1->CCR   = DMA_CCR_MINC | DMA_CCR_CIRC
+#if DUAL_ADC_ENABLE
+                       | DMA_CCR_PSIZE_1 | DMA_CCR_MSIZE_1
+#else
+                       | DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0
+#endif
+                       | DMA_CCR_PL_1 | DMA_CCR_HTIE | DMA_CCR_TCIE;
+  DMA1->IFCR = DMA_IFCR_CGIF1;
+  NVIC_SetPriority(DMA1_Channel1_IRQn, 1);
+  NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+  DMA1_Channel1->CCR |= DMA_CCR_EN;
+
+  // --- ADC1 (+ADC2): scan, jeden sken na trigger TIM3_TRGO, DMA ---
+  // AWD hlídá všechny regular kanály (AWDSGL=0), IRQ až po setWatchWindow()
+  // dual: DUALMOD=0110 regular simultaneous, ADC2 startuje s ADC1
+  // (EXTSEL=111 SWSTART, EXTTRIG=1 podle RM0008), sekvence stejně dlouhé
+  for (uint8_t a = 0; a < ADC_PARALLEL; a++) {
+    ADC_TypeDef* adc = s_adcs[a];
+    adc->CR1 = ADC_CR1_SCAN;
+#if DUAL_ADC_ENABLE
+    if (a == 0) adc->CR1 |= ADC_CR1_DUALMOD_2 | ADC_CR1_DUALMOD_1;
+#endif
+#if AWD_ONSET_ENABLE
+    adc->CR1 |= ADC_CR1_AWDEN;
+    adc->HTR = 4095;
+    adc->LTR = 0;
+#endif
+
+    uint32_t smpr1 = 0, smpr2 = 0, sqr1 = 0, sqr2 = 0, sqr3 = 0;
+    for (uint8_t i = a, n = 0; i < ADC_INPUTS; i += ADC_PARALLEL, n++) {
+      uint8_t ch = ADC_CH[i];
+      if (ch < 10) smpr2 |= (uint32_t)ADC_SMP_CODE << (3 * ch);
+      else         smpr1 |= (uint32_t)ADC_SMP_CODE << (3 * (ch - 10));
+
+      if (n < 6)       sqr3 |= (uint32_t)ch << (5 * n);
+      else if (n < 12) sqr2 |= (uint32_t)ch << (5 * (n - 6));
+      else             sqr1 |= (uint32_t)ch << (5 * (n - 12));
+    }
+    sqr1 |= (uint32_t)(ADC_SLOTS - 1) << ADC_SQR1_L_Pos;
+    adc->SMPR1 = smpr1;
+    adc->SMPR2 = smpr2;
+    adc->SQR1 = sqr1;
+    adc->SQR2 = sqr2;
+    adc->SQR3 = sqr3;
+
+    adc->CR2 = a == 0 ? ADC_CR2_DMA | ADC_CR2_EXTTRIG | ADC_CR2_EXTSEL_2 // EXTSEL=100 TIM3_TRGO
+                      : ADC_CR2_EXTTRIG | ADC_CR2_EXTSEL;                  // EXTSEL=111 SWSTART
+
+    // power-up + kalibrace
+    adc->CR2 |= ADC_CR2_ADON;
+    delayMicroseconds(10);
+    adc->CR2 |= ADC_CR2_RSTCAL;
+    while (adc->CR2 & ADC_CR2_RSTCAL) {}
+    adc->CR2 |= ADC_CR2_CAL;
+    while (adc->CR2 & ADC_CR2_CAL) {}
+  }
+#if AWD_ONSET_ENABLE
+  NVIC_SetPriority(ADC1_2_IRQn, 0);
+  NVIC_EnableIRQ(ADC1_2_IRQn);
+#endif
+
+  // --- TIM3: update => TRGO => start skenu ---
+  s_trig = new HardwareTimer(TIM3);
+  s_trig->setOverflow((uint32_t)SAMPLE_HZ * ADC_SCANS, HERTZ_FORMAT);
+  TIM_TypeDef* t = s_trig->getHandle()->Instance;
+  _psc0 = (uint16_t)t->PSC;
+#if LOCKIN_ENABLE
+  // CH3: toggle na začátku periody => nosná pro vysílače (PB0)
+  // CH4: PWM2, náběžná hrana OC4REF po LOCKIN_SETTLE_US => TRGO => sken
+  s_trig->setMode(3, TIMER_OUTPUT_COMPARE_TOGGLE, LOCKIN_EMITTER_PIN);
+  s_trig->setCaptureCompare(3, 0, TICK_COMPARE_FORMAT);
+  s_trig->setMode(4, TIMER_OUTPUT_COMPARE_PWM2);
+  s_trig->setCaptureCompare(4, LOCKIN_SETTLE_US, MICROSEC_COMPARE_FORMAT);
+  t->CR2 = (t->CR2 & ~TIM_CR2_MMS) | TIM_CR2_MMS; // MMS=111 OC4REF
+#else
+  t->CR2 = (t->CR2 & ~TIM_CR2_MMS) | TIM_CR2_MMS_1; // MMS=010 update
+#endif
+#if MUX_ENABLE
+  // adresy muxů z DMA na update/CC3 téhož TIM3
+  s_mux.begin(t);
+#endif
+  s_trig->resume();
+
+  // počkej na první dávku (Gate::begin() z ní bere baseline)
+  uint32_t t0 = millis();
+  while (_batches == 0) {
+    if (millis() - t0 > 5) return false;
+  }
+  return true;
+}
+
+void AdcScan::setRateDiv(uint8_t div) {
+  if (div == 0) div = 1;
+  if (div == _rateDiv) return;
+  _rateDiv = div;
+  // PSC je bufferovaný => nová perioda od příštího update, sken se neroztrhne
+  if (s_trig) s_trig->getHandle()->Instance->PSC = (uint32_t)(_psc0 + 1) * div - 1;
+}
+
+#else
+
+bool AdcScan::begin() {
+  // host build: žádný ADC, chová se jako fake zdroj; první dávka
+  // z analogRead() => v simulaci (sim/) baseline odpovídá modelu signálu
+  _fake = true;
+  for (uint8_t i = 0; i < GATE_COUNT; i++) inject(i, (uint16_t)analogRead(ADC_PINS[i / MUX_WAYS]));
+  processHalf(0);
+  return true;
+}
+
+void AdcScan::onWatchdog() {}
+
+// host: dávky spouští simulace, rychlost jen oznamuje (sim/Replay.cpp)
+void AdcScan::setRateDiv(uint8_t div) { _rateDiv = div ? div : 1; }
+
+void AdcScan::setWatchWindow(uint16_t lo12, uint16_t hi12, bool arm) {
+  _awdLo = lo12; _awdHi = hi12; _awdArmed = arm;
+}
+
+#endif
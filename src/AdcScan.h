@@ -0,0 +1,83 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// ADC1 (s DUAL_ADC_ENABLE i ADC2 souběžně, vstupy střídavě) v scan režimu přes
+// všechny vstupy (ADC_CH), spouštěný TIM3 (TRGO) pevnou
+// frekvencí SAMPLE_HZ*ADC_SCANS. S muxem (MUX_ENABLE) převádí každý sken
+// jednu adresu všech muxů, adresy přepíná MuxScan. DMA1 Channel1 plní kruhově
+// 2 poloviny _raw; na HT/TC se hotová polovina zdecimuje do _dec
+// (14 bit) a zavolá se onBatch callback => dávky přesně SAMPLE_HZ.
+// LOCKIN_ENABLE: TIM3 CH3 zároveň moduluje vysílače a dávka se
+// synchronně demoduluje (sudé skeny ON, liché OFF).
+// Fake režim: HW se nekonfiguruje, surové vzorky dodává inject()
+// a dávku spouští fakeBatch() (host build / testování bez BluePillu).
+class AdcScan {
+public:
+  typedef void (*BatchFn)();
+
+  // HW: TIM3 + ADC1 + DMA1 Channel1, počká na první dávku
+  bool begin();
+
+  // bez HW, buffer plní volající
+  void beginFake(uint16_t initial = 2048);
+  // surový 12bit vzorek brány pro celou příští dávku
+  void inject(uint8_t ch, uint16_t v);
+  // surový vzorek vstupu ADC v jednom skenu (0..ADC_SCANS-1) příští dávky –
+  // pro simulovaný signál, který se mění mezi skeny (lock-in, šum, mux)
+  void injectRaw(uint8_t scan, uint8_t in, uint16_t v);
+  // celý sken (ADC_INPUTS vstupů) najednou – rychlejší simulace
+  void injectScan(uint8_t scan, const uint16_t v[ADC_INPUTS]);
+  // zpracuje dávku jako DMA HT/TC přerušení
+  void fakeBatch();
+  // dávka rovnou ze zdecimovaných 14bit hodnot (bez oversamplingu a AWD) –
+  // rychlá simulace dlouhých scénářů
+  void fakeDecimated(const uint16_t v14[GATE_COUNT]);
+
+  // volá se z ISR po každé dávce (Sampler::onTick)
+  void onBatch(BatchFn fn) { _onBatch = fn; }
+
+  // zdecimovaná 14bit hodnota kanálu (index brány);
+  // při LOCKIN_ENABLE amplituda paprsku místo DC úrovně
+  uint16_t sample(uint8_t ch) const { return _dec[ch]; }
+  const volatile uint16_t* slot(uint8_t ch) const { return &_dec[ch]; }
+
+  uint32_t batches() const { return _batches; }
+  bool isFake() const { return _fake; }
+
+  // dávky SAMPLE_HZ/div (úsporný režim): TIM3 prescaler x div, rozvrh skenů
+  // (lock-in nosná, adresy muxu) se jen roztáhne. Platí od příštího update TIM3.
+  void setRateDiv(uint8_t div);
+  uint8_t rateDiv() const { return _rateDiv; }
+
+  // --- analog watchdog (AWD) ---
+  // okno v surových 12 bit; arm=false => AWD IRQ vypnuto. Volá Sampler v každé dávce.
+  void setWatchWindow(uint16_t lo12, uint16_t hi12, bool arm);
+  // kandidát na začátek přerušení kanálu ch (DWT cykly), vyzvednutím se smaže
+  bool takeOnset(uint8_t ch, uint32_t& cycles);
+  // DWT cykly na konci poslední dávky
+  uint32_t batchCycles() const { return _batchCycles; }
+
+  // ISR
+  void processHalf(uint8_t half);
+  void onWatchdog();
+
+private:
+  static const uint16_t HALF_LEN = ADC_SCANS * ADC_INPUTS;
+
+  // [polovina][sken][vstup] – pořadí, v jakém je píše DMA
+  // (dual ADC: 32bit přenosy => zarovnání na 4)
+  alignas(4) volatile uint16_t _raw[2 * HALF_LEN] = {0};
+  volatile uint16_t _dec[GATE_COUNT] = {0};
+  volatile uint32_t _batches = 0;
+  volatile uint32_t _batchCycles = 0;
+
+  volatile uint32_t _onsetCycles[GATE_COUNT] = {0};
+  volatile uint32_t _onsetPending = 0;  // bit = kanál
+  uint16_t _awdLo = 0, _awdHi = 4095;
+  volatile bool _awdArmed = false;
+  BatchFn _onBatch = nullptr;
+  bool _fake = false;
+  volatile uint8_t _rateDiv = 1;
+  uint16_t _psc0 = 0;  // prescaler TIM3 pro plnou SAMPLE_HZ
+};
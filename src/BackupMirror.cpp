@@ -0,0 +1,93 @@
+#include "BackupMirror.h"
+
+static const uint8_t REG_MAGIC = 0;
+static const uint8_t REG_DATA  = 1; // DR2..DR9
+static const uint8_t REG_SUM   = 9;
+static const uint8_t PER_REG   = 16 / BackupMirror::DELTA_BITS;
+
+#if IR_HW_STM32
+static void (*s_onPowerFail)() = nullptr;
+
+static inline volatile uint32_t& bkp(uint8_t i) { return (&BKP->DR1)[i]; }
+
+extern "C" void PVD_IRQHandler(void) {
+  EXTI->PR = EXTI_PR_PR16;
+  if (s_onPowerFail) s_onPowerFail();
+}
+#else
+// host: registry v RAM (přežijí "reset" = nové setup() v simulaci)
+static uint32_t s_bkp[10] = {0};
+static inline uint32_t& bkp(uint8_t i) { return s_bkp[i]; }
+#endif
+
+void BackupMirror::begin() {
+#if IR_HW_STM32
+  RCC->APB1ENR |= RCC_APB1ENR_PWREN | RCC_APB1ENR_BKPEN;
+  PWR->CR |= PWR_CR_DBP; // zápis do backup domény
+#endif
+}
+
+void BackupMirror::seal() {
+  uint16_t sum = MAGIC;
+  for (uint8_t i = REG_DATA; i < REG_SUM; i++) sum = (uint16_t)(((sum << 1) | (sum >> 15)) ^ (uint16_t)bkp(i));
+  bkp(REG_SUM) = sum;
+  bkp(REG_MAGIC) = MAGIC;
+}
+
+bool BackupMirror::restore(uint32_t deltas[], uint8_t gateCount) {
+  for (uint8_t g = 0; g < gateCount; g++) deltas[g] = 0;
+  if ((uint16_t)bkp(REG_MAGIC) != MAGIC) return false;
+
+  uint16_t sum = MAGIC;
+  for (uint8_t i = REG_DATA; i < REG_SUM; i++) sum = (uint16_t)(((sum << 1) | (sum >> 15)) ^ (uint16_t)bkp(i));
+  if ((uint16_t)bkp(REG_SUM) != sum) return false;
+
+  for (uint8_t g = 0; g < gateCount && g < GATE_COUNT; g++) {
+    uint16_t r = (uint16_t)bkp(REG_DATA + g / PER_REG);
+    deltas[g] = (r >> ((g % PER_REG) * DELTA_BITS)) & DELTA_MAX;
+  }
+  return true;
+}
+
+void BackupMirror::setDelta(uint8_t gate, uint32_t delta) {
+  if (gate >= GATE_COUNT) return;
+  if (delta > DELTA_MAX) delta = DELTA_MAX;
+  const uint8_t reg = REG_DATA + gate / PER_REG;
+  const uint8_t sh = (uint8_t)((gate % PER_REG) * DELTA_BITS);
+  uint16_t r = (uint16_t)bkp(reg);
+  r = (uint16_t)((r & ~(DELTA_MAX << sh)) | (delta << sh));
+  bkp(reg) = r;
+  seal();
+}
+
+void BackupMirror::clear() {
+  for (uint8_t i = REG_DATA; i < REG_SUM; i++) bkp(i) = 0;
+  seal();
+}
+
+void BackupMirror::enablePvd(void (*onPowerFail)()) {
+#if IR_HW_STM32
+  s_onPowerFail = onPowerFail;
+  PWR->CR = (PWR->CR & ~PWR_CR_PLS) | PWR_CR_PLS_2V9 | PWR_CR_PVDE;
+  // PVDO jde do 1 při poklesu pod práh => EXTI16 náběžná hrana
+  EXTI->IMR  |= EXTI_IMR_MR16;
+  EXTI->RTSR |= EXTI_RTSR_TR16;
+  EXTI->PR = EXTI_PR_PR16;
+  NVIC_SetPriority(PVD_IRQn, 0);
+  NVIC_EnableIRQ(PVD_IRQn);
+#else
+  (void)onPowerFail;
+#endif
+}
+
+void BackupMirror::holdPvd() {
+#if IR_HW_STM32
+  NVIC_DisableIRQ(PVD_IRQn);
+#endif
+}
+
+void BackupMirror::releasePvd() {
+#if IR_HW_STM32
+  NVIC_EnableIRQ(PVD_IRQn);
+#endif
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// Zrcadlo neuložených bodů v backup doméně (BKP DR1..DR10, 10x16 bit)
+// + PVD (hlídání napájení) pro poslední zápis do flash.
+//
+// DR1 = magic, DR2..DR9 = přírůstky od posledního zápisu do flash
+// (DELTA_BITS na bránu), DR10 = kontrolní součet.
+// Pozn.: na BluePillu je VBAT na 3.3 V => registry přežijí reset/brown-out,
+// ale ne úplné odpojení; na to je PVD flush.
+class BackupMirror {
+public:
+  static const uint8_t DELTA_BITS = (GATE_COUNT <= 8) ? 16 : (GATE_COUNT <= 16) ? 8 : 4;
+  static const uint16_t DELTA_MAX = (uint16_t)((1UL << DELTA_BITS) - 1UL);
+  static_assert(GATE_COUNT * DELTA_BITS <= 8 * 16, "BKP: malo registru");
+
+  void begin();
+
+  // přírůstky z minula; false = neplatný obsah (studený start)
+  bool restore(uint32_t deltas[], uint8_t gateCount);
+
+  // přírůstek jedné brány (saturuje na DELTA_MAX)
+  void setDelta(uint8_t gate, uint32_t delta);
+  void clear();
+
+  // PVD: pád pod PVD_LEVEL => callback z přerušení
+  void enablePvd(void (*onPowerFail)());
+  // zákaz/povolení PVD IRQ kolem zápisu do flash z loop()
+  // (čekající PVD se vyřídí hned po release)
+  void holdPvd();
+  void releasePvd();
+
+private:
+  static const uint16_t MAGIC = 0xB7C1;
+  void seal();
+};
@@ -0,0 +1,278 @@
+#include "Bus.h"
+
+#if BUS_ENABLE
+
+static_assert(GATE_COUNT <= bus::MAX_GATES, "REPORT nese max. 8 bran na radic");
+static_assert(BUS_MAX_SLAVES >= 1, "sbernice bez slave");
+
+void Bus::begin(Stream& io, uint8_t dePin, uint8_t addr) {
+  _io = &io;
+  _de = dePin;
+  pinMode(_de, OUTPUT);
+  digitalWrite(_de, LOW); // příjem
+  _txIdle = _io->availableForWrite();
+  setAddr(addr);
+}
+
+void Bus::setAddr(uint8_t addr) {
+  _addr = addr > BUS_MAX_SLAVES ? 0 : addr;
+  _dec.reset();
+  _seq = 0;
+  _waiting = false;
+  _next = 0;
+  for (uint8_t i = 0; i < BUS_MAX_SLAVES; i++) {
+    memset(&_nodes[i], 0, sizeof(Node));
+    _nodes[i].sync = true;
+    _nodes[i].lastTryMs = millis() - BUS_OFFLINE_POLL_MS;
+  }
+  memset(_pending, 0, sizeof(_pending));
+  _needFull = true;
+  _sentAny = false;
+  _evHead = _evCount = _evInflight = 0;
+  _masterArm = false;
+  _polls = 0;
+}
+
+void Bus::resetStats() {
+  for (uint8_t i = 0; i < BUS_MAX_SLAVES; i++) {
+    Node& n = _nodes[i];
+    n.polls = n.reports = n.timeouts = 0;
+    n.latLastUs = n.latMaxUs = 0;
+  }
+  _polls = 0;
+  _lostEvents = 0;
+}
+
+// ------------------------------------------------------------
+// Linka
+// ------------------------------------------------------------
+void Bus::send(uint16_t len) {
+  digitalWrite(_de, HIGH);
+  _io->write(_frame, len);
+  _txBusy = true;
+}
+
+bool Bus::txDone() const {
+#if IR_HW_STM32
+  // TX buffer prázdný a poslední bajt odešel z posuvného registru (USART1 TC)
+  return _io->availableForWrite() >= _txIdle && (USART1->SR & USART_SR_TC);
+#else
+  return true;
+#endif
+}
+
+void Bus::service() {
+  if (!_io) return;
+  if (_txBusy && txDone()) {
+    digitalWrite(_de, LOW);
+    _txBusy = false;
+  }
+
+  while (_io->available() > 0) {
+    _lastRxUs = micros();
+    if (_dec.push((uint8_t)_io->read())) onFrame();
+  }
+
+  if (isMaster()) serviceMaster();
+}
+
+void Bus::onFrame() {
+  const bus::Header& h = _dec.hdr();
+  if (h.dst != _addr) return; // rámec jiného řadiče (RS-485 slyší všichni)
+
+  if (isMaster() && h.type == bus::TYPE_REPORT) {
+    if (!_waiting || h.src != _polled) return; // pozdní odpověď po timeoutu
+    bus::Report r;
+    if (!bus::decodeReport(_dec.payload(), h.len, r)) return;
+    onReport(r, h.seq);
+  } else if (!isMaster() && h.type == bus::TYPE_POLL) {
+    uint8_t ack, flags;
+    if (!bus::decodePoll(_dec.payload(), h.len, ack, flags)) return;
+    onPoll(ack, flags);
+  }
+}
+
+// ------------------------------------------------------------
+// Master
+// ------------------------------------------------------------
+void Bus::serviceMaster() {
+  if (_waiting) {
+    // timeout se počítá od posledního přijatého bajtu => rozjetý REPORT se dočte
+    const uint32_t last = (int32_t)(_lastRxUs - _pollUs) > 0 ? _lastRxUs : _pollUs;
+    if ((uint32_t)(micros() - last) < BUS_REPLY_US) return;
+    Node& n = _nodes[_polled - 1];
+    n.timeouts++;
+    if (n.misses < 255) n.misses++;
+    if (n.misses >= BUS_OFFLINE_MISSES && n.online) {
+      n.online = false;
+      n.sync = true; // mohl se mezitím restartovat / vynulovat
+    }
+    _dec.reset();
+    _waiting = false;
+  }
+  if (!_txBusy) pollNext();
+}
+
+void Bus::pollNext() {
+  const uint32_t now = millis();
+  for (uint8_t k = 0; k < BUS_MAX_SLAVES; k++) {
+    const uint8_t i = (uint8_t)((_next + k) % BUS_MAX_SLAVES);
+    Node& n = _nodes[i];
+    // offline slave jen občas, ať nebrzdí ostatní
+    if (!n.online && (uint32_t)(now - n.lastTryMs) < BUS_OFFLINE_POLL_MS) continue;
+
+    n.lastTryMs = now;
+    n.polls++;
+    const uint8_t flags = (uint8_t)((_armed ? bus::POLL_ARM : 0) | (n.sync ? bus::POLL_SYNC : 0));
+    send(bus::encodePoll(_frame, (uint8_t)(i + 1), _seq++, n.ack, flags));
+    _polled = (uint8_t)(i + 1);
+    _next = (uint8_t)(i + 1);
+    _pollUs = micros();
+    _waiting = true;
+    return;
+  }
+}
+
+void Bus::onReport(const bus::Report& r, uint8_t seq) {
+  Node& n = _nodes[_polled - 1];
+  _waiting = false;
+
+  if (r.flags & bus::REP_FULL) {
+    for (uint8_t g = 0; g < GATE_COUNT; g++) n.counts[g] = g < r.gates ? r.counts[g] : 0;
+    n.sync = false;
+  } else if (!n.sync) {
+    for (uint8_t g = 0; g < GATE_COUNT; g++) n.counts[g] += r.counts[g];
+  }
+  n.broken = r.broken;
+  n.stage = r.stage;
+  n.ack = seq;
+  n.online = true;
+  n.seen = true;
+  n.misses = 0;
+  n.reports++;
+
+  // stáří události na slave + od POLL do teď (obsahuje i reakci slave => horní odhad)
+  const uint32_t sincePoll = micros() - _pollUs;
+  for (uint8_t i = 0; i < r.events; i++) {
+    const bus::Event& e = r.ev[i];
+    if (e.gate >= GATE_COUNT) continue;
+    const uint32_t lat = e.ageUs + sincePoll;
+    n.latLastUs = lat;
+    if (lat > n.latMaxUs) n.latMaxUs = lat;
+    if (_eventFn) _eventFn(_polled, e, lat);
+  }
+}
+
+uint8_t Bus::onlineCount() const {
+  uint8_t c = 0;
+  for (uint8_t i = 0; i < BUS_MAX_SLAVES; i++) c += _nodes[i].online;
+  return c;
+}
+
+uint8_t Bus::globalCounts(const uint32_t local[GATE_COUNT], uint32_t out[BUS_GATES]) const {
+  uint8_t n = GATE_COUNT;
+  for (uint8_t g = 0; g < GATE_COUNT; g++) out[g] = local[g];
+  for (uint8_t i = 0; i < BUS_MAX_SLAVES; i++) {
+    for (uint8_t g = 0; g < GATE_COUNT; g++) out[(i + 1) * GATE_COUNT + g] = _nodes[i].counts[g];
+    if (_nodes[i].seen) n = (uint8_t)((i + 2) * GATE_COUNT);
+  }
+  return n;
+}
+
+GateMask Bus::globalBroken(GateMask local) const {
+  GateMask m = local;
+  for (uint8_t i = 0; i < BUS_MAX_SLAVES; i++) {
+    if (_nodes[i].online) m |= (GateMask)(_nodes[i].broken << ((i + 1) * GATE_COUNT));
+  }
+  return m;
+}
+
+uint8_t Bus::globalStage(uint8_t local) const {
+  uint8_t s = local;
+  for (uint8_t i = 0; i < BUS_MAX_SLAVES; i++) {
+    if (_nodes[i].online && _nodes[i].stage > s) s = _nodes[i].stage;
+  }
+  return s;
+}
+
+uint32_t Bus::latMaxUs() const {
+  uint32_t m = 0;
+  for (uint8_t i = 0; i < BUS_MAX_SLAVES; i++) if (_nodes[i].latMaxUs > m) m = _nodes[i].latMaxUs;
+  return m;
+}
+
+// ------------------------------------------------------------
+// Slave
+// ------------------------------------------------------------
+bool Bus::linked() const {
+  return !isMaster() && _polls && (uint32_t)(millis() - _lastPollMs) < BUS_LINK_MS;
+}
+
+void Bus::noteCount(uint8_t gate) {
+  if (gate < GATE_COUNT) _pending[gate]++;
+}
+
+void Bus::noteEvent(uint8_t kind, uint8_t gate, uint8_t stage, uint32_t bornUs, uint32_t arg) {
+  if (isMaster()) return;
+  if (_evCount >= BUS_EVENT_QUEUE) { _lostEvents++; return; }
+  PendingEvent& p = _ev[(_evHead + _evCount) % BUS_EVENT_QUEUE];
+  p.ev.kind = kind;
+  p.ev.gate = gate;
+  p.ev.stage = stage;
+  p.ev.ageUs = 0;
+  p.ev.arg = arg;
+  p.bornUs = bornUs;
+  _evCount++;
+}
+
+// master potvrdil poslední REPORT
+void Bus::commit() {
+  for (uint8_t g = 0; g < GATE_COUNT; g++) _pending[g] -= _inflight[g];
+  if (_inflightFull) _needFull = false;
+  _evHead = (uint8_t)((_evHead + _evInflight) % BUS_EVENT_QUEUE);
+  _evCount = (uint8_t)(_evCount - _evInflight);
+  _evInflight = 0;
+  memset(_inflight, 0, sizeof(_inflight));
+  _inflightFull = false;
+}
+
+void Bus::onPoll(uint8_t ack, uint8_t flags) {
+  _lastPollMs = millis();
+  _polls++;
+  _masterArm = (flags & bus::POLL_ARM) != 0;
+  if (_sentAny && ack == _seq) commit();
+  // jinak se poslední REPORT ztratil => jeho obsah jde znovu (nový seq)
+  if (flags & bus::POLL_SYNC) _needFull = true;
+
+  bus::Report r;
+  r.broken = _broken;
+  r.stage = _stage;
+  if (_needFull) {
+    r.flags = bus::REP_FULL;
+    r.gates = GATE_COUNT;
+    for (uint8_t g = 0; g < GATE_COUNT; g++) {
+      r.counts[g] = _counts ? _counts[g] : 0;
+      _inflight[g] = _pending[g]; // absolutní počty je už obsahují
+    }
+  } else {
+    for (uint8_t g = 0; g < GATE_COUNT; g++) {
+      r.counts[g] = _pending[g] > 0xFFFF ? 0xFFFF : _pending[g];
+      _inflight[g] = r.counts[g];
+    }
+  }
+  _inflightFull = _needFull;
+
+  const uint32_t now = micros();
+  _evInflight = _evCount < bus::MAX_EVENTS ? _evCount : bus::MAX_EVENTS;
+  r.events = _evInflight;
+  for (uint8_t i = 0; i < _evInflight; i++) {
+    const PendingEvent& p = _ev[(_evHead + i) % BUS_EVENT_QUEUE];
+    r.ev[i] = p.ev;
+    r.ev[i].ageUs = now - p.bornUs;
+  }
+
+  _sentAny = true;
+  send(bus::encodeReport(_frame, _addr, ++_seq, r));
+}
+
+#endif
@@ -0,0 +1,125 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "GateBank.h"
+#include "BusCodec.h"
+
+#if BUS_ENABLE
+
+// Sběrnice řadičů (RS-485 přes USART1 + budič s DE): víc BluePillů = víc bran.
+// Master (adresa 0) dokola posílá POLL slave 1..BUS_MAX_SLAVES a z REPORTů
+// skládá globální tabulku počtů (brána slave i = i*GATE_COUNT + g), masku
+// přerušených bran a nejvyšší stupeň alarmu. Slave jen odpovídá: přírůstky
+// počtů a události přerušení od posledního potvrzeného REPORTu (BusCodec.h).
+// service() z loop() nikdy neblokuje: vybere přijaté bajty, hlídá timeout
+// odpovědi (micros) a DE drží jen do odeslání posledního bajtu.
+class Bus {
+public:
+  // stav slave z pohledu mastera
+  struct Node {
+    uint32_t counts[GATE_COUNT];
+    GateMask broken;
+    uint8_t stage;
+    bool online;
+    bool seen;            // aspoň jednou odpověděl
+    bool sync;            // čeká na absolutní počty (FULL)
+    uint8_t ack;          // seq posledního přijatého REPORT
+    uint8_t misses;       // timeouty za sebou
+    uint32_t lastTryMs;
+    uint32_t polls, reports, timeouts;
+    uint32_t latLastUs, latMaxUs; // událost na slave -> zpracování u mastera (horní odhad)
+  };
+
+  // master: událost ze slave (node 1..), latence v us
+  typedef void (*EventFn)(uint8_t node, const bus::Event& e, uint32_t latencyUs);
+
+  void begin(Stream& io, uint8_t dePin, uint8_t addr);
+  // 0 = master, 1..BUS_MAX_SLAVES = slave; stav sběrnice se vynuluje
+  void setAddr(uint8_t addr);
+  uint8_t addr() const { return _addr; }
+  bool isMaster() const { return _addr == 0; }
+
+  // loop()
+  void service();
+
+  // --- slave ---
+  void setCounts(const uint32_t* counts) { _counts = counts; }
+  void noteCount(uint8_t gate);
+  // bornUs = čas události v micros()
+  void noteEvent(uint8_t kind, uint8_t gate, uint8_t stage, uint32_t bornUs, uint32_t arg);
+  // počty se změnily jinak než přírůstkem (reset) => příště absolutně
+  void requestFull() { _needFull = true; }
+  void setLocal(GateMask broken, uint8_t stage) { _broken = broken; _stage = stage; }
+  // POLL od mastera v posledních BUS_LINK_MS
+  bool linked() const;
+  bool masterArmed() const { return _masterArm; }
+  uint32_t polls() const { return _polls; }
+  uint32_t lostEvents() const { return _lostEvents; }
+
+  // --- master ---
+  void setArmed(bool on) { _armed = on; }
+  void onEvent(EventFn fn) { _eventFn = fn; }
+  const Node& node(uint8_t i) const { return _nodes[i - 1]; }
+  uint8_t onlineCount() const;
+  // globální pohled: vlastní brány + brány slave (offline => poslední známé počty);
+  // vrací počet bran včetně posledního slave, který se kdy ozval
+  uint8_t globalCounts(const uint32_t local[GATE_COUNT], uint32_t out[BUS_GATES]) const;
+  GateMask globalBroken(GateMask local) const;
+  uint8_t globalStage(uint8_t local) const;
+  uint32_t latMaxUs() const;
+
+  uint32_t crcErrors() const { return _dec.crcErrors(); }
+  void resetStats();
+
+private:
+  struct PendingEvent {
+    bus::Event ev;   // ageUs zatím nevyplněné
+    uint32_t bornUs;
+  };
+
+  Stream* _io = nullptr;
+  uint8_t _de = 0;
+  uint8_t _addr = 0;
+  int _txIdle = 0;          // availableForWrite() s prázdným TX bufferem
+  bool _txBusy = false;
+  bus::Decoder _dec;
+  uint8_t _frame[bus::MAX_FRAME];
+  uint8_t _seq = 0;
+
+  // master
+  Node _nodes[BUS_MAX_SLAVES];
+  bool _armed = false;
+  bool _waiting = false;
+  uint8_t _polled = 0;      // slave, od kterého čekáme REPORT
+  uint8_t _next = 0;        // round-robin
+  uint32_t _pollUs = 0;
+  uint32_t _lastRxUs = 0;
+  EventFn _eventFn = nullptr;
+
+  // slave
+  const uint32_t* _counts = nullptr;
+  uint32_t _pending[GATE_COUNT] = {0};
+  uint32_t _inflight[GATE_COUNT] = {0};
+  bool _needFull = true;    // po startu absolutně (master mohl počty nemít)
+  bool _inflightFull = false;
+  bool _sentAny = false;
+  PendingEvent _ev[BUS_EVENT_QUEUE];
+  uint8_t _evHead = 0, _evCount = 0, _evInflight = 0;
+  uint32_t _lostEvents = 0;
+  GateMask _broken = 0;
+  uint8_t _stage = 0;
+  bool _masterArm = false;
+  uint32_t _lastPollMs = 0;
+  uint32_t _polls = 0;
+
+  void send(uint16_t len);
+  bool txDone() const;
+  void onFrame();
+  void serviceMaster();
+  void pollNext();
+  void onReport(const bus::Report& r, uint8_t seq);
+  void onPoll(uint8_t ack, uint8_t flags);
+  void commit();
+};
+
+#endif
@@ -0,0 +1,243 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "TeleCodec.h"   // tele::crc16
+
+// Protokol sběrnice řadičů (Bus.h) po RS-485 / UART. Master (adresa 0) se
+// postupně ptá slave 1..N, slave vysílá jen jako odpověď na svůj POLL =>
+// na půlduplexní lince nikdy nevysílají dva najednou.
+//
+// Rámec:  SYNC | dst | src | typ | seq | len | payload[len] | crc16 LE
+//         crc16 = CCITT (0xFFFF) přes dst..payload (stejné jako telemetrie).
+// POLL   (master -> slave): ack u8 = seq posledního přijatého REPORT, flags u8
+// REPORT (slave -> master): flags u8, broken u32, stage u8, pak
+//         FULL:  gates u8, count u32 x gates           (absolutní počty)
+//         jinak: n u8, { gate u8, delta u16 } x n      (přírůstky)
+//         ne u8, { kind u8, gate u8, stage u8, age u32, arg u32 } x ne
+// Slave drží přírůstky a události, dokud POLL nepotvrdí (ack) seq REPORTu,
+// ve kterém odešly; ztracený REPORT se pošle znovu s novým seq => nic se
+// neztratí ani nezapočítá dvakrát. age = us od události do sestavení REPORTu.
+namespace bus {
+
+static const uint8_t SYNC        = 0x5A;
+static const uint8_t TYPE_POLL   = 'P';
+static const uint8_t TYPE_REPORT = 'R';
+
+static const uint8_t HDR_LEN     = 6;   // SYNC, dst, src, typ, seq, len
+static const uint8_t CRC_LEN     = 2;
+static const uint8_t MAX_PAYLOAD = 128;
+static const uint16_t MAX_FRAME  = HDR_LEN + MAX_PAYLOAD + CRC_LEN;
+
+static const uint8_t MAX_GATES   = 8;   // bran na řadič
+static const uint8_t MAX_EVENTS  = 4;   // událostí v jednom REPORTu
+
+// POLL flags
+static const uint8_t POLL_ARM  = 0x01;  // slave převezme ARM mastera
+static const uint8_t POLL_SYNC = 0x02;  // master chce absolutní počty (FULL)
+// REPORT flags
+static const uint8_t REP_FULL  = 0x01;
+
+// události REPORTu
+static const uint8_t EV_BREAK_START = 1; // arg = 0
+static const uint8_t EV_BREAK_END   = 2; // arg = délka [ms], stage = max. stupeň
+
+static const uint8_t EVENT_BYTES = 11;
+static_assert(6 + 1 + MAX_GATES * 4 + 1 + MAX_EVENTS * EVENT_BYTES <= MAX_PAYLOAD, "REPORT se nevejde");
+
+struct Event {
+  uint8_t kind;
+  uint8_t gate;    // brána řadiče 0..
+  uint8_t stage;
+  uint32_t ageUs;
+  uint32_t arg;
+};
+
+struct Report {
+  uint8_t flags = 0;
+  uint32_t broken = 0;
+  uint8_t stage = 0;
+  uint8_t gates = 0;                  // FULL
+  uint32_t counts[MAX_GATES] = {0};   // FULL: absolutně, jinak přírůstky (0 = beze změny)
+  uint8_t events = 0;
+  Event ev[MAX_EVENTS];
+};
+
+struct Header {
+  uint8_t dst, src, type, seq, len;
+};
+
+// ------------------------------------------------------------
+// Kódování
+// ------------------------------------------------------------
+class Writer {
+public:
+  explicit Writer(uint8_t* buf) : _p(buf + HDR_LEN), _start(buf) {}
+  void put8(uint8_t v) { *_p++ = v; }
+  void put16(uint16_t v) { put8((uint8_t)v); put8((uint8_t)(v >> 8)); }
+  void put32(uint32_t v) { put16((uint16_t)v); put16((uint16_t)(v >> 16)); }
+  uint8_t len() const { return (uint8_t)(_p - _start - HDR_LEN); }
+  uint8_t* pos() { return _p; }
+
+private:
+  uint8_t* _p;
+  uint8_t* _start;
+};
+
+// doplní hlavičku a CRC kolem payloadu zapsaného za buf[HDR_LEN]; vrací délku rámce
+inline uint16_t frame(uint8_t* buf, uint8_t dst, uint8_t src, uint8_t type, uint8_t seq, uint8_t len) {
+  buf[0] = SYNC;
+  buf[1] = dst;
+  buf[2] = src;
+  buf[3] = type;
+  buf[4] = seq;
+  buf[5] = len;
+  uint16_t crc = 0xFFFF;
+  const uint16_t end = (uint16_t)(HDR_LEN + len);
+  for (uint16_t i = 1; i < end; i++) crc = tele::crc16(crc, buf[i]);
+  buf[end] = (uint8_t)crc;
+  buf[end + 1] = (uint8_t)(crc >> 8);
+  return (uint16_t)(end + CRC_LEN);
+}
+
+inline uint16_t encodePoll(uint8_t* buf, uint8_t dst, uint8_t seq, uint8_t ack, uint8_t flags) {
+  Writer w(buf);
+  w.put8(ack);
+  w.put8(flags);
+  return frame(buf, dst, 0, TYPE_POLL, seq, w.len());
+}
+
+inline uint16_t encodeReport(uint8_t* buf, uint8_t src, uint8_t seq, const Report& r) {
+  Writer w(buf);
+  w.put8(r.flags);
+  w.put32(r.broken);
+  w.put8(r.stage);
+  if (r.flags & REP_FULL) {
+    w.put8(r.gates);
+    for (uint8_t g = 0; g < r.gates; g++) w.put32(r.counts[g]);
+  } else {
+    uint8_t* n = w.pos();
+    w.put8(0);
+    for (uint8_t g = 0; g < MAX_GATES; g++) {
+      if (!r.counts[g]) continue;
+      w.put8(g);
+      w.put16((uint16_t)(r.counts[g] > 0xFFFF ? 0xFFFF : r.counts[g]));
+      (*n)++;
+    }
+  }
+  w.put8(r.events);
+  for (uint8_t i = 0; i < r.events; i++) {
+    w.put8(r.ev[i].kind);
+    w.put8(r.ev[i].gate);
+    w.put8(r.ev[i].stage);
+    w.put32(r.ev[i].ageUs);
+    w.put32(r.ev[i].arg);
+  }
+  return frame(buf, 0, src, TYPE_REPORT, seq, w.len());
+}
+
+// ------------------------------------------------------------
+// Dekódování (bajt po bajtu, po chybě CRC hledá další SYNC)
+// ------------------------------------------------------------
+class Reader {
+public:
+  Reader(const uint8_t* p, uint8_t len) : _p(p), _end(p + len) {}
+  uint8_t get8() { if (_p >= _end) { _ok = false; return 0; } return *_p++; }
+  uint16_t get16() { uint16_t v = get8(); return (uint16_t)(v | (get8() << 8)); }
+  uint32_t get32() { uint32_t v = get16(); return v | ((uint32_t)get16() << 16); }
+  bool ok() const { return _ok; }
+
+private:
+  const uint8_t* _p;
+  const uint8_t* _end;
+  bool _ok = true;
+};
+
+inline bool decodePoll(const uint8_t* p, uint8_t len, uint8_t& ack, uint8_t& flags) {
+  Reader r(p, len);
+  ack = r.get8();
+  flags = r.get8();
+  return r.ok();
+}
+
+inline bool decodeReport(const uint8_t* p, uint8_t len, Report& out) {
+  Reader r(p, len);
+  out = Report();
+  out.flags = r.get8();
+  out.broken = r.get32();
+  out.stage = r.get8();
+  if (out.flags & REP_FULL) {
+    out.gates = r.get8();
+    if (out.gates > MAX_GATES) return false;
+    for (uint8_t g = 0; g < out.gates; g++) out.counts[g] = r.get32();
+  } else {
+    const uint8_t n = r.get8();
+    for (uint8_t i = 0; i < n; i++) {
+      const uint8_t g = r.get8();
+      const uint16_t d = r.get16();
+      if (g >= MAX_GATES) return false;
+      out.counts[g] += d;
+    }
+  }
+  out.events = r.get8();
+  if (out.events > MAX_EVENTS) return false;
+  for (uint8_t i = 0; i < out.events; i++) {
+    Event& e = out.ev[i];
+    e.kind = r.get8();
+    e.gate = r.get8();
+    e.stage = r.get8();
+    e.ageUs = r.get32();
+    e.arg = r.get32();
+  }
+  return r.ok();
+}
+
+class Decoder {
+public:
+  // true = v hdr()/payload() je celý rámec se správným CRC
+  bool push(uint8_t b) {
+    if (_len == 0 && b != SYNC) { _skipped++; return false; }
+    _buf[_len++] = b;
+    if (_len == HDR_LEN && _buf[5] > MAX_PAYLOAD) { resync(); return false; }
+    if (_len < HDR_LEN || _len < (uint16_t)(HDR_LEN + _buf[5] + CRC_LEN)) return false;
+
+    uint16_t crc = 0xFFFF;
+    const uint16_t end = (uint16_t)(HDR_LEN + _buf[5]);
+    for (uint16_t i = 1; i < end; i++) crc = tele::crc16(crc, _buf[i]);
+    if (crc != (uint16_t)(_buf[end] | (_buf[end + 1] << 8))) { _crcErrors++; resync(); return false; }
+
+    _hdr.dst = _buf[1];
+    _hdr.src = _buf[2];
+    _hdr.type = _buf[3];
+    _hdr.seq = _buf[4];
+    _hdr.len = _buf[5];
+    _len = 0;
+    return true;
+  }
+
+  void reset() { _len = 0; }
+  bool receiving() const { return _len != 0; }
+  const Header& hdr() const { return _hdr; }
+  const uint8_t* payload() const { return _buf + HDR_LEN; }
+  uint32_t crcErrors() const { return _crcErrors; }
+  uint32_t skipped() const { return _skipped; }
+
+private:
+  uint8_t _buf[MAX_FRAME];
+  uint16_t _len = 0;
+  Header _hdr;
+  uint32_t _crcErrors = 0;
+  uint32_t _skipped = 0;
+
+  // chybný rámec: zkusit další SYNC uvnitř už přijatých bajtů
+  // (rámec, který se v nich najde celý, se zahodí – přijde znovu)
+  void resync() {
+    uint8_t tmp[MAX_FRAME];
+    const uint16_t n = _len;
+    memcpy(tmp, _buf, n);
+    _len = 0;
+    _skipped++;
+    for (uint16_t i = 1; i < n; i++) push(tmp[i]);
+  }
+};
+
+} // namespace bus
@@ -0,0 +1,136 @@
+#include "Buttons.h"
+
+static const uint32_t DEBOUNCE_US = (uint32_t)BTN_DEBOUNCE_MS * 1000UL;
+
+static Buttons* s_buttons = nullptr;
+
+static void onEdge0() { s_buttons->onEdge(0); }
+static void onEdge1() { s_buttons->onEdge(1); }
+
+void Buttons::begin(const uint8_t pins[COUNT], const BtnGestureCfg cfg[COUNT]) {
+  static void (*const ISR[COUNT])() = { onEdge0, onEdge1 };
+  s_buttons = this;
+  const uint32_t now = micros();
+  for (uint8_t b = 0; b < COUNT; b++) {
+    Line& l = _line[b];
+    l.pin = pins[b];
+    pinMode(l.pin, INPUT_PULLUP);
+    l.stable = l.raw = digitalRead(l.pin) == LOW;
+    l.burstUs = l.lastUs = now - DEBOUNCE_US;
+
+    Rec& r = _rec[b];
+    memset(&r, 0, sizeof(r));
+    r.cfg = cfg[b];
+    // držené při startu není gesto (jeho uvolnění se zahodí)
+    attachInterrupt(digitalPinToInterrupt(l.pin), ISR[b], CHANGE);
+  }
+}
+
+// ------------------------------------------------------------
+// Debounce (ISR)
+// ------------------------------------------------------------
+void Buttons::confirm(uint8_t b) {
+  Line& l = _line[b];
+  l.stable = l.raw;
+  Edge e;
+  e.button = b;
+  e.pressed = l.raw;
+  e.tUs = l.burstUs;
+  _edges.push(e); // plno = 16 nezpracovaných hran, loop() stojí přes 0.4 s stisků
+}
+
+void Buttons::onEdge(uint8_t b) {
+  Line& l = _line[b];
+  const uint32_t now = micros();
+  const bool level = digitalRead(l.pin) == LOW;
+
+  if ((uint32_t)(now - l.lastUs) >= DEBOUNCE_US) {
+    // předchozí úroveň vydržela => platí (s časem své první hrany); začíná nový shluk
+    if (l.raw != l.stable) confirm(b);
+    l.burstUs = now;
+  } else {
+    _bounces++;
+  }
+  l.raw = level;
+  l.lastUs = now;
+}
+
+// ------------------------------------------------------------
+// Gesta (loop)
+// ------------------------------------------------------------
+void Buttons::emit(BtnEvt type, uint8_t b, uint16_t arg, uint32_t tUs) {
+  BtnEvent e;
+  e.type = type;
+  e.button = b;
+  e.arg = arg;
+  e.tUs = tUs;
+  _events.push(e);
+}
+
+// časová gesta, která nastala do nowUs
+void Buttons::advance(uint8_t b, uint32_t nowUs) {
+  Rec& r = _rec[b];
+  const BtnGestureCfg& c = r.cfg;
+
+  if (r.seq) {
+    const uint32_t gapEnd = r.lastPressUs + (uint32_t)c.seqGapMs * 1000UL;
+    const uint32_t winEnd = r.seqStartUs + (uint32_t)c.seqWindowMs * 1000UL;
+    const uint32_t end = (int32_t)(gapEnd - winEnd) < 0 ? gapEnd : winEnd;
+    // mezera se měří od posledního stisku, i když se ještě drží
+    if ((int32_t)(nowUs - end) > 0) {
+      emit(BtnEvt::Sequence, b, r.seq, end);
+      r.seq = 0;
+    }
+  }
+
+  if (!r.down) return;
+  const uint32_t held = nowUs - r.downUs;
+  if (c.holdMs && !r.holdDone && held >= (uint32_t)c.holdMs * 1000UL) {
+    r.holdDone = true;
+    emit(BtnEvt::Hold, b, 0, r.downUs + (uint32_t)c.holdMs * 1000UL);
+  }
+  if (c.stageMs) {
+    const uint32_t stageUs = (uint32_t)c.stageMs * 1000UL;
+    while (r.stage < 255 && held >= (uint32_t)(r.stage + 1) * stageUs) {
+      r.stage++;
+      emit(BtnEvt::HoldStage, b, r.stage, r.downUs + (uint32_t)r.stage * stageUs);
+    }
+  }
+}
+
+void Buttons::onConfirmed(const Edge& e) {
+  const uint8_t b = e.button;
+  Rec& r = _rec[b];
+  advance(b, e.tUs);
+  if (e.pressed == r.down) return;
+
+  if (e.pressed) {
+    r.down = true;
+    r.downUs = e.tUs;
+    r.holdDone = false;
+    r.stage = 0;
+    if (r.seq == 0) r.seqStartUs = e.tUs;
+    if (r.seq < 255) r.seq++;
+    r.lastPressUs = e.tUs;
+    emit(BtnEvt::Press, b, 0, e.tUs);
+  } else {
+    r.down = false;
+    const uint32_t ms = (e.tUs - r.downUs) / 1000UL;
+    emit(BtnEvt::Release, b, (uint16_t)(ms > 0xFFFF ? 0xFFFF : ms), e.tUs);
+  }
+}
+
+void Buttons::service() {
+  // poslední úroveň bez další hrany potvrdí až čas
+  for (uint8_t b = 0; b < COUNT; b++) {
+    Line& l = _line[b];
+    noInterrupts();
+    if (l.raw != l.stable && (uint32_t)(micros() - l.lastUs) >= DEBOUNCE_US) confirm(b);
+    interrupts();
+  }
+
+  Edge e;
+  while (_edges.pop(e)) onConfirmed(e);
+  const uint32_t now = micros();
+  for (uint8_t b = 0; b < COUNT; b++) advance(b, now);
+}
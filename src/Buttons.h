@@ -0,0 +1,90 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "SpscRing.h"
+
+// Tlačítka přes EXTI (obě hrany) s časem hrany z micros().
+// Odskoky řeší ISR: shluk hran začíná hranou po >= BTN_DEBOUNCE_MS klidu,
+// nová úroveň platí, až vydrží BTN_DEBOUNCE_MS (potvrdí ji další hrana
+// nebo service()), a nese čas první hrany shluku. Krátký zákmit se
+// nepotvrdí vůbec.
+// service() z loop() z potvrzených hran skládá gesta podle jejich časů,
+// ne podle toho, kdy loop() proběhl => dlouhý blokující zvuk ani pomalý
+// průchod nic neztratí ani neposune.
+enum class BtnEvt : uint8_t {
+  Press = 0,   // stisk
+  Release,     // uvolnění, arg = délka stisku (ms)
+  Sequence,    // série stisků ukončená mezerou seqGapMs nebo oknem seqWindowMs, arg = počet
+  Hold,        // drží holdMs (jednou za stisk)
+  HoldStage,   // drží dál: každých stageMs další stupeň, arg = 1, 2, 3, ...
+};
+
+struct BtnEvent {
+  BtnEvt type;
+  uint8_t button;  // 0 = T1, 1 = T2
+  uint16_t arg;
+  uint32_t tUs;    // čas gesta (micros) odvozený z hran
+};
+
+// 0 = gesto vypnuté
+struct BtnGestureCfg {
+  uint16_t seqGapMs;
+  uint16_t seqWindowMs;
+  uint16_t holdMs;
+  uint16_t stageMs;
+};
+
+class Buttons {
+public:
+  static const uint8_t COUNT = 2;
+
+  // INPUT_PULLUP, aktivní LOW
+  void begin(const uint8_t pins[COUNT], const BtnGestureCfg cfg[COUNT]);
+
+  // loop(): potvrdí ustálenou poslední úroveň, hrany -> gesta
+  void service();
+  bool pollEvent(BtnEvent& e) { return _events.pop(e); }
+
+  bool isPressed(uint8_t b) const { return _rec[b].down; }
+  uint32_t bounces() const { return _bounces; }
+
+  // EXTI
+  void onEdge(uint8_t b);
+
+private:
+  struct Edge {
+    uint8_t button;
+    bool pressed;
+    uint32_t tUs;
+  };
+
+  // debounce (ISR, service() s vypnutými přerušeními)
+  struct Line {
+    uint8_t pin;
+    volatile bool stable;   // potvrzená úroveň (true = stisk)
+    volatile bool raw;      // úroveň po poslední hraně
+    volatile uint32_t burstUs, lastUs;
+  };
+
+  // rozpoznávání (jen loop())
+  struct Rec {
+    BtnGestureCfg cfg;
+    bool down;
+    uint32_t downUs;
+    bool holdDone;
+    uint8_t stage;
+    uint8_t seq;
+    uint32_t seqStartUs, lastPressUs;
+  };
+
+  Line _line[COUNT];
+  Rec _rec[COUNT];
+  SpscRing<Edge, 16> _edges;        // ISR -> loop
+  SpscRing<BtnEvent, 16> _events;   // service() -> loop
+  volatile uint32_t _bounces = 0;
+
+  void confirm(uint8_t b);
+  void advance(uint8_t b, uint32_t nowUs);
+  void onConfirmed(const Edge& e);
+  void emit(BtnEvt type, uint8_t b, uint16_t arg, uint32_t tUs);
+};
@@ -1,95 +1,366 @@
 #include "Buzzer.h"
 #include "config.h"
 
+// ------------------------------------------------------------
+// Signature zvuky
+// ------------------------------------------------------------
+static const BeepStep STEPS_BOOT[]       = { {2000, 60}, {0, 60}, {2000, 60} };
+static const BeepStep STEPS_CLICK[]      = { {2400, 25} };
+static const BeepStep STEPS_ENTER_DIAG[] = { {2400, 60}, {0, 35}, {2400, 60}, {0, 35}, {2400, 60} };
+static const BeepStep STEPS_ENTER_RUN[]  = { {1800, 240} };
+static const BeepStep STEPS_IDLE_SET[]   = { {2000, 70}, {0, 60}, {2000, 70} };
+static const BeepStep STEPS_RESET_DONE[] = { {2000, 80}, {0, 80}, {2000, 80}, {0, 80}, {2000, 80} };
+static const BeepStep STEPS_ZERO_SET[]   = { {1800, 180} };
+static const BeepStep STEPS_MAX_SET[]    = { {2200, 60}, {0, 60}, {2200, 60} };
+static const BeepStep STEPS_FAULT[]      = { {800, 400}, {0, 200}, {800, 400}, {0, 1000} };
+
+#define PATTERN(steps) { steps, (uint8_t)(sizeof(steps) / sizeof(steps[0])) }
+const BeepPattern PAT_BOOT       = PATTERN(STEPS_BOOT);
+const BeepPattern PAT_CLICK      = PATTERN(STEPS_CLICK);
+const BeepPattern PAT_ENTER_DIAG = PATTERN(STEPS_ENTER_DIAG);
+const BeepPattern PAT_ENTER_RUN  = PATTERN(STEPS_ENTER_RUN);
+const BeepPattern PAT_IDLE_SET   = PATTERN(STEPS_IDLE_SET);
+const BeepPattern PAT_RESET_DONE = PATTERN(STEPS_RESET_DONE);
+const BeepPattern PAT_ZERO_SET   = PATTERN(STEPS_ZERO_SET);
+const BeepPattern PAT_MAX_SET    = PATTERN(STEPS_MAX_SET);
+const BeepPattern PAT_FAULT      = PATTERN(STEPS_FAULT);
+#undef PATTERN
+
+// ------------------------------------------------------------
+// Syntéza: tabulky půlperiod [us] počítá překladač (constexpr => flash)
+// ------------------------------------------------------------
+template <uint16_t N>
+struct HalfTable {
+  uint16_t us[N];
+};
+
+// siréna: frekvence lineárně SIREN_LO_HZ..SIREN_HI_HZ, index = horní bity fáze
+static const uint8_t  SWEEP_BITS = 8;
+static const uint16_t SWEEP_STEPS = 1U << SWEEP_BITS;
+// fáze za 1 us: 2^32 = nahoru + dolů
+static const uint32_t SWEEP_INC_PER_US = (uint32_t)((1ULL << 31) / ((uint32_t)SIREN_SWEEP_MS * 1000UL));
+
+static constexpr HalfTable<SWEEP_STEPS> makeSweep() {
+  HalfTable<SWEEP_STEPS> t{};
+  for (uint16_t i = 0; i < SWEEP_STEPS; i++) {
+    const uint32_t hz = SIREN_LO_HZ + (uint32_t)(SIREN_HI_HZ - SIREN_LO_HZ) * i / (SWEEP_STEPS - 1);
+    t.us[i] = (uint16_t)((500000UL + hz / 2) / hz);
+  }
+  return t;
+}
+static constexpr HalfTable<SWEEP_STEPS> SWEEP_HALF = makeSweep();
+static_assert(SWEEP_HALF.us[0] > SWEEP_HALF.us[SWEEP_STEPS - 1], "sirena: SIREN_LO_HZ < SIREN_HI_HZ");
+
+// noty: rovnoměrně temperované ladění, A4 (MIDI 69) = 440 Hz
+static const uint8_t NOTE_LO = 72;     // C5
+static const uint8_t NOTE_COUNT = 36;  // .. B7
+static const uint16_t REST_HALF_US = 500; // pauza: časovač dál tiká po 1 ms
+
+static constexpr HalfTable<NOTE_COUNT> makeNotes() {
+  HalfTable<NOTE_COUNT> t{};
+  double hz = 440.0;
+  for (uint8_t n = 69; n < NOTE_LO; n++) hz *= 1.0594630943592953;
+  for (uint8_t i = 0; i < NOTE_COUNT; i++) {
+    t.us[i] = (uint16_t)(500000.0 / hz + 0.5);
+    hz *= 1.0594630943592953;
+  }
+  return t;
+}
+static constexpr HalfTable<NOTE_COUNT> NOTE_HALF = makeNotes();
+static_assert(NOTE_HALF.us[81 - NOTE_LO] == 568, "A5 = 880 Hz");
+
+enum : uint8_t {
+  NOTE_REST = 0,
+  NOTE_C7 = 96, NOTE_D7 = 98, NOTE_E7 = 100, NOTE_G7 = 103,
+};
+
+static const SynthNote NOTES_ALARM[] = {
+  {NOTE_E7, 12}, {NOTE_C7, 12}, {NOTE_E7, 12}, {NOTE_C7, 12},
+  {NOTE_G7, 24}, {NOTE_REST, 6}, {NOTE_G7, 12}, {NOTE_E7, 12},
+  {NOTE_D7, 12}, {NOTE_C7, 24}, {NOTE_REST, 20},
+};
+const Melody MEL_ALARM = { NOTES_ALARM, (uint8_t)(sizeof(NOTES_ALARM) / sizeof(NOTES_ALARM[0])) };
+
+#if IR_HW_STM32
+// Časovač běží na 1 MHz, perioda = ARR+1 us, CCR = půlperioda.
+// Kanál A v PWM1, kanál B v PWM2 => výstupy jsou vždy v protifázi.
+static HardwareTimer* s_pwm = nullptr;
+static TIM_TypeDef*   s_tim = nullptr;
+
+static const uint32_t OCM_FORCE_LOW = 4; // 100: forced inactive
+static const uint32_t OCM_PWM1      = 6; // 110
+static const uint32_t OCM_PWM2      = 7; // 111
+
+static void ocMode(uint8_t ch, uint32_t m) {
+  volatile uint32_t* ccmr = (ch <= 2) ? &s_tim->CCMR1 : &s_tim->CCMR2;
+  uint8_t sh = ((ch - 1) & 1) ? 12 : 4;           // OCxM
+  *ccmr = (*ccmr & ~(7UL << sh)) | (m << sh) | (1UL << (sh - 1)); // + OCxPE
+}
+
+static inline volatile uint32_t& ccr(uint8_t ch) { return (&s_tim->CCR1)[ch - 1]; }
+
+// do preloadu (ARPE, OCxPE) => platí od příštího update, perioda se neroztrhne
+static inline void hwLoad(uint16_t halfUs) {
+  s_tim->ARR = (uint32_t)halfUs * 2UL - 1UL;
+  ccr(PZ_CH_A) = halfUs;
+  ccr(PZ_CH_B) = halfUs;
+}
+
+static inline void hwOutputs(bool on) {
+  ocMode(PZ_CH_A, on ? OCM_PWM1 : OCM_FORCE_LOW);
+  ocMode(PZ_CH_B, on ? OCM_PWM2 : OCM_FORCE_LOW);
+}
+
+static Buzzer* s_buzzer = nullptr;
+// přes HardwareTimer (vlastní TIMx_IRQHandler má jádro), syntéza sama je pár instrukcí
+static void onPzUpdate() { s_buzzer->onPeriod(); }
+#endif
+
 void Buzzer::begin(uint8_t pinA, uint8_t pinB) {
   _a = pinA; _b = pinB;
+#if IR_HW_STM32
+#if USE_PIEZO_PORT_B
+  s_pwm = new HardwareTimer(TIM4);
+#else
+  s_pwm = new HardwareTimer(TIM1);
+#endif
+  s_pwm->setMode(PZ_CH_A, TIMER_OUTPUT_COMPARE_PWM1, _a);
+  s_pwm->setMode(PZ_CH_B, TIMER_OUTPUT_COMPARE_PWM2, _b);
+  s_pwm->setPrescaleFactor(s_pwm->getTimerClkFreq() / 1000000UL);
+  s_pwm->setOverflow(1000, TICK_FORMAT);
+  s_pwm->setCaptureCompare(PZ_CH_A, 500, TICK_COMPARE_FORMAT);
+  s_pwm->setCaptureCompare(PZ_CH_B, 500, TICK_COMPARE_FORMAT);
+  s_pwm->resume();
+  s_tim = s_pwm->getHandle()->Instance;
+  s_tim->CR1 |= TIM_CR1_ARPE;
+  s_buzzer = this;
+  s_pwm->attachInterrupt(onPzUpdate);
+  s_tim->DIER &= ~TIM_DIER_UIE; // zapíná jen siréna / melodie
+#else
   pinMode(_a, OUTPUT);
   pinMode(_b, OUTPUT);
-  off();
+#endif
+  _voice = Voice::Tone; // vynutí hwOff()
+  stop();
   _nextDiagBeepMs = 0;
+  _diagBeepOn = false;
 }
 
 void Buzzer::off() {
+  if (_pat) return;
+  hwOff();
+}
+
+void Buzzer::stop() {
+  _pat = nullptr;
+  _qCount = 0;
+  hwOff();
+}
+
+void Buzzer::hwOff() {
+  if (_voice == Voice::Off) return;
+  _voice = Voice::Off; // rozběhnutá onPeriod() už nic nezapíše
+  _hz = 0;
+  _rest = false;
+#if IR_HW_STM32
+  s_tim->DIER &= ~TIM_DIER_UIE;
+  hwOutputs(false);
+  s_tim->EGR = TIM_EGR_UG; // hned, ne až na konci periody
+#else
   digitalWrite(_a, LOW);
   digitalWrite(_b, LOW);
+#endif
 }
 
-inline void Buzzer::toneStep(uint32_t halfPeriodUs) {
-  digitalWrite(_a, HIGH);
-  digitalWrite(_b, LOW);
-  delayMicroseconds(halfPeriodUs);
-  digitalWrite(_a, LOW);
-  digitalWrite(_b, HIGH);
-  delayMicroseconds(halfPeriodUs);
+void Buzzer::startVoice(Voice v, uint16_t halfUs, bool mute) {
+  const bool fromOff = _voice == Voice::Off;
+#if IR_HW_STM32
+  s_tim->DIER &= ~TIM_DIER_UIE;
+#endif
+  _voice = v;
+  _rest = mute;
+  _nextHalf = halfUs;
+  if (fromOff) _runHalf = halfUs;
+#if IR_HW_STM32
+  hwLoad(halfUs);
+  hwOutputs(!mute);
+  // z ticha: načti preload hned; jinak se nová perioda načte sama na update – bez lupnutí
+  if (fromOff) s_tim->EGR = TIM_EGR_UG;
+  if (v == Voice::Sweep || v == Voice::Melody) {
+    s_tim->SR = ~TIM_SR_UIF; // UG nastavil i UIF
+    s_tim->DIER |= TIM_DIER_UIE;
+  }
+#endif
+}
+
+void Buzzer::tone(uint16_t hz) {
+  if (hz == 0) { hwOff(); return; }
+  if (_voice == Voice::Tone && hz == _hz) return;
+  startVoice(Voice::Tone, (uint16_t)(500000UL / (uint32_t)hz), false);
+  _hz = hz;
+}
+
+void Buzzer::siren() {
+  if (_voice == Voice::Sweep) return;
+  _phase = 0; // od SIREN_LO_HZ
+  startVoice(Voice::Sweep, SWEEP_HALF.us[0], false);
+}
+
+void Buzzer::melody(const Melody& m) {
+  if (_voice == Voice::Melody && _mel == &m) return;
+#if IR_HW_STM32
+  s_tim->DIER &= ~TIM_DIER_UIE;
+#endif
+  _mel = &m;
+  _noteIdx = 0;
+  _noteLeftUs = 0;
+  const uint16_t h = nextNote();
+  startVoice(Voice::Melody, h, _rest);
 }
 
-void Buzzer::toneChunk(uint16_t hz, uint16_t steps) {
-  const uint32_t halfPeriodUs = 1000000UL / ((uint32_t)hz * 2UL);
-  for (uint16_t i = 0; i < steps; i++) toneStep(halfPeriodUs);
+uint16_t Buzzer::nextNote() {
+  if (_noteIdx >= _mel->count) _noteIdx = 0;
+  const SynthNote& n = _mel->notes[_noteIdx++];
+  _noteLeftUs += (int32_t)n.len * 10000L;
+  _rest = n.note == NOTE_REST;
+  return _rest ? REST_HALF_US : NOTE_HALF.us[n.note - NOTE_LO];
+}
+
+void Buzzer::onPeriod() {
+  // skončila perioda _runHalf, běží ta z preloadu; teď se zapisuje přespříští
+  const uint32_t doneUs = (uint32_t)_runHalf * 2UL;
+  _runHalf = _nextHalf;
+  uint16_t h;
+  if (_voice == Voice::Sweep) {
+    // fáze úměrná času => lineární sweep nezávislý na délce period
+    _phase += doneUs * SWEEP_INC_PER_US;
+    uint32_t i = _phase >> (31 - SWEEP_BITS);
+    if (i >= SWEEP_STEPS) i = 2U * SWEEP_STEPS - 1U - i; // cesta dolů
+    h = SWEEP_HALF.us[i];
+  } else if (_voice == Voice::Melody) {
+    _noteLeftUs -= (int32_t)doneUs;
+    if (_noteLeftUs > 0) return;
+    const bool wasRest = _rest;
+    h = nextNote();
+#if IR_HW_STM32
+    if (_rest != wasRest) hwOutputs(!_rest);
+#else
+    (void)wasRest;
+#endif
+  } else {
+    return;
+  }
+  _nextHalf = h;
+#if IR_HW_STM32
+  hwLoad(h);
+#endif
+}
+
+#if !IR_HW_STM32
+void Buzzer::simAdvance(uint32_t us) {
+  if (_voice != Voice::Sweep && _voice != Voice::Melody) { _simUs = 0; return; }
+  _simUs += us;
+  while (_simUs >= 2UL * _runHalf) {
+    _simUs -= 2UL * _runHalf;
+    onPeriod();
+  }
 }
+#endif
 
-void Buzzer::beepMs(uint16_t hz, uint16_t ms) {
-  const uint32_t halfPeriodUs = 1000000UL / ((uint32_t)hz * 2UL);
-  const uint32_t cycles = (uint32_t)ms * 1000UL / (halfPeriodUs * 2UL);
-  for (uint32_t i = 0; i < cycles; i++) toneStep(halfPeriodUs);
-  off();
+uint16_t Buzzer::currentHz() const {
+  if (_voice == Voice::Off || _rest) return 0;
+  if (_voice == Voice::Tone) return _hz;
+  return (uint16_t)(500000UL / _runHalf);
 }
 
-void Buzzer::click() {
-  beepMs(2400, 25);
+bool Buzzer::play(const BeepPattern& p) {
+  if (p.count == 0) return false;
+  if (_qCount >= QUEUE_LEN) return false;
+  _queue[(uint8_t)((_qHead + _qCount) % QUEUE_LEN)] = &p;
+  _qCount++;
+  if (!_pat) service(millis());
+  return true;
 }
 
-uint16_t Buzzer::sirenFreq(uint32_t tMs) {
-  const uint32_t period = (uint32_t)SIREN_SWEEP_MS * 2UL;
-  uint32_t x = tMs % period;
-  uint32_t up = (x <= SIREN_SWEEP_MS) ? x : (period - x);
-  uint32_t span = (uint32_t)SIREN_HI_HZ - (uint32_t)SIREN_LO_HZ;
-  return (uint16_t)((uint32_t)SIREN_LO_HZ + (span * up) / (uint32_t)SIREN_SWEEP_MS);
+void Buzzer::startStep(uint32_t startMs) {
+  _stepEndMs = startMs + _pat->steps[_step].ms;
+  tone(_pat->steps[_step].hz);
+}
+
+void Buzzer::service(uint32_t nowMs) {
+  // další krok počítáme od konce předchozího (ne od now) => bez driftu;
+  // když loop zaspí, zmeškané kroky se přeskočí
+  while (_pat && (int32_t)(nowMs - _stepEndMs) >= 0) {
+    if (++_step < _pat->count) { startStep(_stepEndMs); continue; }
+    _pat = nullptr;
+    hwOff();
+  }
+  if (!_pat && _qCount) {
+    _pat = _queue[_qHead];
+    _qHead = (uint8_t)((_qHead + 1) % QUEUE_LEN);
+    _qCount--;
+    _step = 0;
+    startStep(nowMs);
+  }
 }
 
 void Buzzer::tick(SoundMode mode, uint32_t nowMs) {
+  if (_pat) return;
+
   switch (mode) {
     case SoundMode::Off:
       off();
       break;
 
     case SoundMode::GateInterruptedStage1:
-      toneChunk(TONE_STAGE1_HZ);
+      tone(TONE_STAGE1_HZ);
       break;
 
     case SoundMode::GateInterruptedStage2: {
       uint32_t t = nowMs % BEEP1_PERIOD_MS;
-      if (t < BEEP1_ON_MS) toneChunk(TONE_STAGE1_HZ);
-      else { off(); delay(2); }
+      if (t < BEEP1_ON_MS) tone(TONE_STAGE1_HZ);
+      else off();
     } break;
 
     case SoundMode::GateInterruptedStage3: {
       uint32_t t = nowMs % BEEP2_PERIOD_MS;
-      if (t < BEEP2_ON_MS) toneChunk(TONE_STAGE1_HZ);
-      else { off(); delay(2); }
+      if (t < BEEP2_ON_MS) tone(TONE_STAGE1_HZ);
+      else off();
     } break;
 
     case SoundMode::GateInterruptedSiren:
-      toneChunk(sirenFreq(nowMs));
+      siren();
+      break;
+
+    case SoundMode::GateInterruptedMelody:
+      melody(MEL_ALARM);
       break;
   }
 }
 
-void Buzzer::tickDiagMeter(uint32_t nowMs, int16_t diff) {
-  // pod prahem ticho
-  if (diff < (int16_t)DELTA_ON) {
+void Buzzer::tickDiagMeter(uint32_t nowMs, int16_t level) {
+  if (_pat) return;
+
+  // doběhnutí rozjetého pípnutí
+  if (_diagBeepOn && (int32_t)(nowMs - _diagBeepEndMs) >= 0) {
+    _diagBeepOn = false;
     off();
+  }
+
+  // pod prahem ticho
+  if (level < (int16_t)DIAG_LEVEL_ON) {
+    if (!_diagBeepOn) off();
     // aby po návratu nezačal “okamžitě” v divné fázi
     if (_nextDiagBeepMs < nowMs) _nextDiagBeepMs = nowMs;
     return;
   }
 
-  // mapování: diff nad DELTA_ON -> perioda 800..120 ms
-  int32_t x = (int32_t)diff - (int32_t)DELTA_ON;
+  // mapování: úroveň nad DIAG_LEVEL_ON -> perioda 800..120 ms
+  int32_t x = (int32_t)level - (int32_t)DIAG_LEVEL_ON;
   if (x < 0) x = 0;
 
-  // “perf” hranice: DELTA_ON + DIAG_DIFF_PERF
-  int32_t xmax = (int32_t)DIAG_DIFF_PERF;
+  // “perf” hranice: DIAG_LEVEL_ON + DIAG_LEVEL_PERF
+  int32_t xmax = (int32_t)DIAG_LEVEL_PERF;
   if (x > xmax) x = xmax;
 
   int32_t period = (int32_t)DIAG_PERIOD_SLOW_MS
@@ -98,10 +369,10 @@ void Buzzer::tickDiagMeter(uint32_t nowMs, int16_t diff) {
   if (period < (int32_t)DIAG_PERIOD_FAST_MS) period = (int32_t)DIAG_PERIOD_FAST_MS;
 
   if (nowMs >= _nextDiagBeepMs) {
-    beepMs(DIAG_BEEP_HZ, DIAG_BEEP_MS);
+    tone(DIAG_BEEP_HZ);
+    _diagBeepOn = true;
+    _diagBeepEndMs = nowMs + DIAG_BEEP_MS;
     _nextDiagBeepMs = nowMs + (uint32_t)period;
-  } else {
-    // nic – necháme loop běžet
-    off();
   }
+  // jinak nic – necháme loop běžet
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <Arduino.h>
+#include "config.h"
 
 enum class SoundMode : uint8_t {
   Off = 0,
@@ -7,33 +8,127 @@ enum class SoundMode : uint8_t {
   GateInterruptedStage2,
   GateInterruptedStage3,
   GateInterruptedSiren,
+  GateInterruptedMelody,
 };
 
+// Krok zvukového vzoru: tón hz po dobu ms (hz=0 => pauza)
+struct BeepStep {
+  uint16_t hz;
+  uint16_t ms;
+};
+
+struct BeepPattern {
+  const BeepStep* steps;
+  uint8_t count;
+};
+
+// Nota melodie: MIDI číslo 72..107 (C5..B7, 0 = pauza), délka v 10 ms
+struct SynthNote {
+  uint8_t note;
+  uint8_t len;
+};
+
+// melodie hraje dokola, dokud ji něco nepřebije
+struct Melody {
+  const SynthNote* notes;
+  uint8_t count;
+};
+
+// Signature zvuky (spec)
+extern const BeepPattern PAT_BOOT;        // 2x 2000 Hz
+extern const BeepPattern PAT_CLICK;       // klik 2400 Hz
+extern const BeepPattern PAT_ENTER_DIAG;  // 3x krátké 2400 Hz
+extern const BeepPattern PAT_ENTER_RUN;   // 1x dlouhé 1800 Hz
+extern const BeepPattern PAT_IDLE_SET;    // 2x 2000 Hz
+extern const BeepPattern PAT_RESET_DONE;  // 3x 2000 Hz
+extern const BeepPattern PAT_ZERO_SET;    // 1x 1800 Hz ~180 ms
+extern const BeepPattern PAT_MAX_SET;     // 2x krátké 2200 Hz
+extern const BeepPattern PAT_FAULT;       // 2x dlouhé 800 Hz (HW chyba, opakuje se)
+
+extern const Melody MEL_ALARM;            // alarm (spec: po 3 s "alarm / melodie")
+
+// Piezo jako komplementární push-pull pár z HW časovače
+// (TIM4 CH3/CH4 na PB8/PB9, TIM1 CH1/CH2 na PA8/PA9).
+// Tón běží sám v HW, tick() jen nastaví frekvenci a hned se vrátí.
+// Siréna a melodie: syntéza v přerušení časovače na konci každé periody
+// tónu – fázový akumulátor (siréna) / zbývající čas noty (melodie) vybere
+// půlperiodu z constexpr tabulky ve flash a zapíše ji do preloadu ARR/CCR.
+// Plynulý sweep bez dělení, loop() jen syntézu spustí.
 class Buzzer {
 public:
   void begin(uint8_t pinA, uint8_t pinB);
 
-  // Jednorázové pípnutí (používej pro boot/confirm)
-  void beepMs(uint16_t hz, uint16_t ms);
+  // Zařadí vzor do fronty a hned se vrátí (boot/confirm zvuky).
+  // Hrající vzor má přednost před tick()/tickDiagMeter().
+  bool play(const BeepPattern& p);
+
+  // posouvá vzory – volat z loop() (nebo z timeru)
+  void service(uint32_t nowMs);
+
+  bool isPlaying() const { return _pat != nullptr; }
 
   // 1x krátké “klik” potvrzení
-  void click();
+  void click() { play(PAT_CLICK); }
 
+  // ticho pro alarm/DIAG vrstvu (rozehraný vzor nechá doběhnout)
   void off();
 
-  // RUN alarm tick (chunk)
+  // ticho úplně, včetně fronty vzorů
+  void stop();
+
+  // RUN alarm tick – neblokuje
   void tick(SoundMode mode, uint32_t nowMs);
 
-  // DIAG “geiger” tick – pípá rychleji podle diff
-  void tickDiagMeter(uint32_t nowMs, int16_t diff);
+  // DIAG “geiger” tick – pípá rychleji podle úrovně (0.1 %), neblokuje
+  void tickDiagMeter(uint32_t nowMs, int16_t level);
+
+  // aktuálně hrající frekvence (0 = ticho)
+  uint16_t currentHz() const;
+
+  // ISR časovače (update = konec periody): další krok sirény / melodie
+  void onPeriod();
+#if !IR_HW_STM32
+  // host: uplynulý čas => onPeriod() jako z časovače (sim/Replay.cpp)
+  void simAdvance(uint32_t us);
+#endif
 
 private:
+  enum class Voice : uint8_t { Off = 0, Tone, Sweep, Melody };
+
   uint8_t _a = 255, _b = 255;
+  uint16_t _hz = 0;                  // Voice::Tone
+
+  // syntéza (po spuštění mění jen onPeriod())
+  volatile Voice _voice = Voice::Off;
+  volatile bool _rest = false;       // pauza melodie: výstupy LOW, časovač běží dál
+  volatile uint16_t _runHalf = 0;    // půlperioda právě běžící periody [us]
+  uint16_t _nextHalf = 0;            // v preloadu, platí od příštího update
+  uint32_t _phase = 0;               // siréna: 2^32 = nahoru i dolů (2x SIREN_SWEEP_MS)
+  const Melody* _mel = nullptr;
+  uint8_t _noteIdx = 0;
+  int32_t _noteLeftUs = 0;
+#if !IR_HW_STM32
+  uint32_t _simUs = 0;
+#endif
 
   // pro DIAG plánování pípnutí
   uint32_t _nextDiagBeepMs = 0;
+  uint32_t _diagBeepEndMs = 0;
+  bool _diagBeepOn = false;
+
+  // fronta vzorů
+  static const uint8_t QUEUE_LEN = 4;
+  const BeepPattern* _queue[QUEUE_LEN] = {nullptr};
+  uint8_t _qHead = 0, _qCount = 0;
+  const BeepPattern* _pat = nullptr;
+  uint8_t _step = 0;
+  uint32_t _stepEndMs = 0;
 
-  inline void toneStep(uint32_t halfPeriodUs);
-  void toneChunk(uint16_t hz, uint16_t steps = 60);
-  uint16_t sirenFreq(uint32_t tMs);
+  void startStep(uint32_t startMs);
+  void hwOff();
+  void tone(uint16_t hz);
+  void siren();
+  void melody(const Melody& m);
+  void startVoice(Voice v, uint16_t halfUs, bool mute);
+  uint16_t nextNote();
 };
@@ -0,0 +1,99 @@
+#include "CalStore.h"
+
+uint16_t CalStore::crc16(uint16_t crc, uint16_t w) {
+  // CRC-16/CCITT, po bajtech půlslova (LE)
+  for (uint8_t b = 0; b < 2; b++) {
+    crc ^= (uint16_t)((uint8_t)(w >> (8 * b))) << 8;
+    for (uint8_t k = 0; k < 8; k++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+  }
+  return crc;
+}
+
+bool CalStore::slotErased(uint8_t page, uint16_t slot) const {
+  const uint16_t off = slot * REC_BYTES;
+  for (uint16_t k = 0; k < REC_BYTES; k += 2) {
+    if (_flash->read16(page, off + k) != 0xFFFF) return false;
+  }
+  return true;
+}
+
+bool CalStore::slotValid(uint8_t page, uint16_t slot, uint32_t& seq) const {
+  const uint16_t off = slot * REC_BYTES;
+  if (_flash->read16(page, off) != MAGIC) return false;
+  uint16_t vg = _flash->read16(page, off + 2);
+  if ((uint8_t)vg != VERSION || (uint8_t)(vg >> 8) != GATE_COUNT) return false;
+
+  uint16_t crc = 0xFFFF;
+  for (uint16_t k = 2; k < REC_BYTES - 2; k += 2) crc = crc16(crc, _flash->read16(page, off + k));
+  if (crc != _flash->read16(page, off + REC_BYTES - 2)) return false;
+
+  seq = _flash->read32(page, off + 4);
+  return true;
+}
+
+void CalStore::begin(FlashIo& flash) {
+  _flash = &flash;
+  _have = false;
+  for (uint8_t p = 0; p < flash.pageCount(); p++) {
+    for (uint16_t s = 0; s < slotsPerPage(); s++) {
+      uint32_t seq;
+      if (!slotValid(p, s, seq)) continue;
+      if (!_have || (int32_t)(seq - _seq) > 0) {
+        _have = true;
+        _page = p;
+        _slot = s;
+        _seq = seq;
+      }
+    }
+  }
+}
+
+bool CalStore::load(GateCal cal[], uint8_t gateCount) {
+  if (!_have || gateCount != GATE_COUNT) return false;
+  const uint16_t off = _slot * REC_BYTES + 8;
+  for (uint8_t g = 0; g < gateCount; g++) {
+    uint16_t w[sizeof(GateCal) / 2];
+    for (uint8_t k = 0; k < sizeof(w) / 2; k++) w[k] = _flash->read16(_page, off + g * sizeof(GateCal) + k * 2);
+    memcpy(&cal[g], w, sizeof(GateCal));
+  }
+  return true;
+}
+
+bool CalStore::save(const GateCal cal[], uint8_t gateCount) {
+  if (!_flash || gateCount != GATE_COUNT) return false;
+
+  // další smazaný slot za posledním záznamem, jinak druhá stránka
+  uint8_t page = _page;
+  uint16_t slot = _have ? (uint16_t)(_slot + 1) : 0;
+  while (slot < slotsPerPage() && !slotErased(page, slot)) slot++;
+  if (slot >= slotsPerPage()) {
+    page = (uint8_t)((_page + 1) % _flash->pageCount());
+    slot = 0;
+    if (!_flash->erase(page)) return false;
+  }
+
+  const uint16_t off = slot * REC_BYTES;
+  const uint32_t seq = _seq + 1;
+  uint16_t crc = 0xFFFF;
+  auto put = [&](uint16_t at, uint16_t w) {
+    crc = crc16(crc, w);
+    return _flash->program16(page, off + at, w);
+  };
+
+  bool ok = put(2, (uint16_t)(VERSION | (GATE_COUNT << 8)))
+         && put(4, (uint16_t)seq) && put(6, (uint16_t)(seq >> 16));
+  for (uint8_t g = 0; ok && g < gateCount; g++) {
+    uint16_t w[sizeof(GateCal) / 2];
+    memcpy(w, &cal[g], sizeof(GateCal));
+    for (uint8_t k = 0; ok && k < sizeof(w) / 2; k++) ok = put(8 + g * sizeof(GateCal) + k * 2, w[k]);
+  }
+  ok = ok && _flash->program16(page, off + REC_BYTES - 2, crc)
+          && _flash->program16(page, off, MAGIC); // až nakonec => záznam platí
+  if (!ok) return false;
+
+  _have = true;
+  _page = page;
+  _slot = slot;
+  _seq = seq;
+  return true;
+}
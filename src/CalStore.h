@@ -0,0 +1,35 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "FlashIo.h"
+#include "GateBank.h"
+
+// Verzovaný záznam kalibrace všech bran ve flash (2 stránky, střídavě).
+// Sloty pevné délky: {magic, verze, počet bran, seq32, GateCal[n], crc16}.
+// Platí záznam s nejvyšším seq a správným CRC; magic se píše poslední,
+// takže přerušený zápis se neuplatní. Když je stránka plná, smaže se
+// ta druhá – předchozí záznam tak platí až do dokončení nového.
+class CalStore {
+public:
+  static const uint8_t VERSION = 1;
+
+  void begin(FlashIo& flash);
+  bool load(GateCal cal[], uint8_t gateCount);
+  bool save(const GateCal cal[], uint8_t gateCount);
+
+private:
+  static const uint16_t MAGIC = 0xCA1B;
+  static const uint16_t REC_BYTES = 8 + sizeof(GateCal) * GATE_COUNT + 2;
+  static_assert(sizeof(GateCal) == 10, "GateCal layout");
+
+  FlashIo* _flash = nullptr;
+  bool     _have = false;
+  uint8_t  _page = 0;
+  uint16_t _slot = 0;   // slot posledního platného záznamu
+  uint32_t _seq = 0;
+
+  bool slotValid(uint8_t page, uint16_t slot, uint32_t& seq) const;
+  bool slotErased(uint8_t page, uint16_t slot) const;
+  uint16_t slotsPerPage() const { return (uint16_t)(_flash->pageSize() / REC_BYTES); }
+  static uint16_t crc16(uint16_t crc, uint16_t w);
+};
@@ -0,0 +1,53 @@
+#include "Console.h"
+
+void Console::begin(Stream& io) {
+  _io = &io;
+  _len = 0;
+}
+
+bool Console::add(const char* name, CmdFn fn, const char* help) {
+  if (_count >= MAX_CMDS) return false;
+  _cmds[_count].name = name;
+  _cmds[_count].fn = fn;
+  _cmds[_count].help = help;
+  _count++;
+  return true;
+}
+
+void Console::poll() {
+  if (!_io) return;
+  while (_io->available() > 0) {
+    int c = _io->read();
+    if (c < 0) break;
+    if (c == '\r' || c == '\n') {
+      if (_len) dispatch();
+      _len = 0;
+    } else if (_len < LINE_LEN - 1) {
+      _line[_len++] = (char)c;
+    }
+  }
+}
+
+void Console::dispatch() {
+  _line[_len] = 0;
+
+  char* args = _line;
+  while (*args && *args != ' ') args++;
+  if (*args) *args++ = 0;
+  while (*args == ' ') args++;
+
+  for (uint8_t i = 0; i < _count; i++) {
+    if (strcmp(_line, _cmds[i].name) == 0) { _cmds[i].fn(*_io, args); return; }
+  }
+
+  // neznámý příkaz / "help" => seznam
+  if (strcmp(_line, "help") != 0) {
+    _io->print("? ");
+    _io->println(_line);
+  }
+  for (uint8_t i = 0; i < _count; i++) {
+    _io->print(_cmds[i].name);
+    _io->print(" - ");
+    _io->println(_cmds[i].help);
+  }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <Arduino.h>
+
+// Řádkové příkazy přes sériovou linku (115200, "\n" nebo "\r").
+// poll() z loop() jen vybere, co přišlo – nikdy neblokuje čtením.
+// Příkaz = první slovo, zbytek řádku dostane handler jako args.
+class Console {
+public:
+  typedef void (*CmdFn)(Print& out, const char* args);
+
+  void begin(Stream& io);
+  bool add(const char* name, CmdFn fn, const char* help);
+  void poll();
+
+private:
+  static const uint8_t MAX_CMDS = 12;
+  static const uint8_t LINE_LEN = 48;
+
+  struct Cmd {
+    const char* name;
+    CmdFn fn;
+    const char* help;
+  };
+
+  Stream* _io = nullptr;
+  Cmd _cmds[MAX_CMDS];
+  uint8_t _count = 0;
+  char _line[LINE_LEN];
+  uint8_t _len = 0;
+
+  void dispatch();
+};
@@ -0,0 +1,109 @@
+#include "CounterJournal.h"
+
+uint8_t CounterJournal::crc8(uint16_t seq, uint8_t gate, uint32_t count) {
+  const uint8_t b[7] = {
+    (uint8_t)seq, (uint8_t)(seq >> 8), gate,
+    (uint8_t)count, (uint8_t)(count >> 8), (uint8_t)(count >> 16), (uint8_t)(count >> 24)
+  };
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i < sizeof(b); i++) {
+    crc ^= b[i];
+    for (uint8_t k = 0; k < 8; k++) crc = (uint8_t)((crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1));
+  }
+  return crc;
+}
+
+bool CounterJournal::begin(FlashIo& flash, uint32_t counts[], uint8_t gateCount) {
+  _flash = &flash;
+  _valid = false;
+  for (uint8_t i = 0; i < gateCount; i++) counts[i] = 0;
+
+  // aktivní stránka = platná hlavička s nejvyšším pageSeq
+  for (uint8_t p = 0; p < flash.pageCount(); p++) {
+    if (flash.read16(p, 0) != MAGIC) continue;
+    uint32_t ps = flash.read32(p, 4);
+    if (!_valid || (int32_t)(ps - _pageSeq) > 0) {
+      _valid = true;
+      _page = p;
+      _pageSeq = ps;
+    }
+  }
+  if (!_valid) return false;
+
+  // přehrání záznamů v pořadí zápisu, poslední vyhrává. Celá stránka:
+  // append() přeskakuje nesmazané sloty, takže za roztrženým (i za smazaným
+  // po chybě zápisu) můžou být platné záznamy
+  const uint16_t size = flash.pageSize();
+  uint16_t end = HDR_BYTES;
+  for (uint16_t off = HDR_BYTES; off + REC_BYTES <= size; off += REC_BYTES) {
+    uint16_t w0 = flash.read16(_page, off);
+    uint16_t w1 = flash.read16(_page, off + 2);
+    uint32_t count = flash.read32(_page, off + 4);
+    if (w0 == 0xFFFF && w1 == 0xFFFF && count == 0xFFFFFFFFUL) continue; // smazaný
+    end = (uint16_t)(off + REC_BYTES);
+
+    uint8_t gate = (uint8_t)w1;
+    uint8_t crc  = (uint8_t)(w1 >> 8);
+    // seq se píše poslední => bez něj roztržený zápis (výpadek); vadné CRC taky přeskočit
+    if (w0 == 0xFFFF || crc != crc8(w0, gate, count) || gate >= gateCount) continue;
+    _seq = (uint16_t)(w0 + 1);
+    counts[gate] = count;
+  }
+  _next = end;
+  return true;
+}
+
+uint16_t CounterJournal::freeSlots() const {
+  if (!_valid) return 0;
+  return (uint16_t)((_flash->pageSize() - _next) / REC_BYTES);
+}
+
+bool CounterJournal::writeRec(uint8_t page, uint16_t off, uint8_t gate, uint32_t count) {
+  // počet a CRC dřív, seq (první půlslovo = příznak obsazení) poslední;
+  // 0xFFFF je "nezapsáno" => přeskočit
+  uint16_t seq = _seq == 0xFFFF ? 0 : _seq;
+  bool ok = _flash->program16(page, off + 4, (uint16_t)count)
+         && _flash->program16(page, off + 6, (uint16_t)(count >> 16))
+         && _flash->program16(page, off + 2, (uint16_t)(gate | ((uint16_t)crc8(seq, gate, count) << 8)))
+         && _flash->program16(page, off, seq);
+  _seq = (uint16_t)(seq + 1);
+  return ok;
+}
+
+bool CounterJournal::compact(const uint32_t snapshot[], uint8_t gateCount) {
+  if (!_flash) return false;
+  const uint8_t np = _valid ? (uint8_t)((_page + 1) % _flash->pageCount()) : 0;
+  if (!_flash->erase(np)) return false;
+
+  uint16_t off = HDR_BYTES;
+  for (uint8_t i = 0; i < gateCount; i++, off += REC_BYTES) {
+    if (!writeRec(np, off, i, snapshot[i])) return false;
+  }
+
+  // hlavička až nakonec => stránka platí, až když je snapshot celý
+  const uint32_t ps = _valid ? _pageSeq + 1 : 1;
+  if (!_flash->program16(np, 4, (uint16_t)ps)) return false;
+  if (!_flash->program16(np, 6, (uint16_t)(ps >> 16))) return false;
+  if (!_flash->program16(np, 0, MAGIC)) return false;
+
+  _page = np;
+  _pageSeq = ps;
+  _next = off;
+  _valid = true;
+  return true;
+}
+
+bool CounterJournal::append(uint8_t gate, uint32_t count, const uint32_t snapshot[], uint8_t gateCount) {
+  if (!_valid || freeSlots() == 0) return compact(snapshot, gateCount);
+  // slot může být po výpadku napůl zapsaný => přeskočit nesmazané
+  while (freeSlots() > 0) {
+    uint16_t off = _next;
+    _next += REC_BYTES;
+    bool erased = true;
+    for (uint8_t k = 0; k < REC_BYTES; k += 2) {
+      if (_flash->read16(_page, off + k) != 0xFFFF) { erased = false; break; }
+    }
+    if (erased) return writeRec(_page, off, gate, count);
+  }
+  return compact(snapshot, gateCount);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "FlashIo.h"
+
+// Append-only žurnál počítadel přes >= 2 stránky flash (wear leveling).
+//
+// Stránka: hlavička {magic, 0xFFFF, pageSeq32} + záznamy po 8 B:
+//   {seq16, gate8, crc8, count32}
+// Aktivní = platná stránka s nejvyšším pageSeq. Nový záznam jde na první
+// smazaný slot; roztržený (seq se píše poslední) se při startu přeskočí. Když je stránka plná, zkompaktuje se: další stránka se smaže,
+// zapíše se snapshot všech bran a hlavička až nakonec (výpadek napájení
+// uprostřed => stránka bez hlavičky se ignoruje, platí ta stará).
+class CounterJournal {
+public:
+  // projde flash, obnoví counts[] (chybějící = 0); false = žádná platná stránka
+  bool begin(FlashIo& flash, uint32_t counts[], uint8_t gateCount);
+
+  // přidá záznam (gate -> count); při plné stránce kompaktuje ze snapshotu
+  bool append(uint8_t gate, uint32_t count, const uint32_t snapshot[], uint8_t gateCount);
+
+  // založí novou stránku se snapshotem (i migrace / první start)
+  bool compact(const uint32_t snapshot[], uint8_t gateCount);
+
+  uint16_t freeSlots() const;
+  uint32_t pageSeq() const { return _pageSeq; }
+
+private:
+  static const uint16_t MAGIC = 0x4A31; // "J1"
+  static const uint8_t  HDR_BYTES = 8;
+  static const uint8_t  REC_BYTES = 8;
+
+  FlashIo* _flash = nullptr;
+  uint8_t  _page = 0;
+  uint32_t _pageSeq = 0;
+  uint16_t _next = 0;    // offset dalšího volného slotu
+  uint16_t _seq = 0;
+  bool     _valid = false;
+
+  bool writeRec(uint8_t page, uint16_t off, uint8_t gate, uint32_t count);
+  static uint8_t crc8(uint16_t seq, uint8_t gate, uint32_t count);
+};
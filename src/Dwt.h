@@ -0,0 +1,21 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// Cortex-M3 DWT cycle counter (72 MHz => 13.9 ns, přetečení po ~59 s).
+// Na hostu emulace přes micros().
+static const uint32_t CPU_MHZ = 72;
+
+#if IR_HW_STM32
+inline void dwtBegin() {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+inline uint32_t dwtCycles() { return DWT->CYCCNT; }
+#else
+inline void dwtBegin() {}
+inline uint32_t dwtCycles() { return micros() * CPU_MHZ; }
+#endif
+
+inline uint32_t dwtCyclesToUs(uint32_t cycles) { return cycles / CPU_MHZ; }
@@ -0,0 +1,139 @@
+#include "EventLog.h"
+
+static const uint16_t MARK_TORN = 0xFEFE; // přerušený zápis (gate 0xFE)
+
+bool EventLog::pageValid(uint8_t p, uint32_t& seq) const {
+  if (_flash->read16(p, 0) != MAGIC) return false;
+  seq = _flash->read32(p, 4);
+  return true;
+}
+
+void EventLog::scanPage(uint8_t p) {
+  uint16_t n = 0;
+  for (; n < slotsPerPage(); n++) {
+    const uint16_t off = HDR_BYTES + n * REC_BYTES;
+    if (_flash->read16(p, off + REC_BYTES - 2) != 0xFFFF) continue;
+
+    bool erased = true;
+    for (uint16_t k = 0; k < REC_BYTES - 2; k += 2) {
+      if (_flash->read16(p, off + k) != 0xFFFF) { erased = false; break; }
+    }
+    if (erased) break;
+    // data bez značky => slot zavřít, aby se za něj dalo psát dál
+    _flash->program16(p, off + REC_BYTES - 2, MARK_TORN);
+  }
+  _used[p] = n;
+}
+
+void EventLog::begin(FlashIo& flash) {
+  _flash = &flash;
+  _ramLen = 0;
+  _flashCount = 0;
+
+  bool have = false;
+  for (uint8_t p = 0; p < pages(); p++) {
+    uint32_t seq;
+    _used[p] = 0;
+    if (!pageValid(p, seq)) continue;
+    scanPage(p);
+    _flashCount += _used[p];
+    if (!have || (int32_t)(seq - _seq) > 0) {
+      have = true;
+      _head = p;
+      _seq = seq;
+    }
+  }
+
+  if (!have) startPage(0, 1);
+  _slot = _used[_head];
+}
+
+bool EventLog::startPage(uint8_t p, uint32_t seq) {
+  _flashCount -= _used[p];
+  _used[p] = 0;
+  _head = p;
+  _seq = seq;
+  _slot = 0;
+  return _flash->erase(p)
+      && _flash->program16(p, 4, (uint16_t)seq)
+      && _flash->program16(p, 6, (uint16_t)(seq >> 16))
+      && _flash->program16(p, 0, MAGIC);
+}
+
+bool EventLog::writeRecord(const BreakRecord& r) {
+  if (_slot >= slotsPerPage()) {
+    if (!startPage((uint8_t)((_head + 1) % pages()), _seq + 1)) return false;
+  }
+
+  uint16_t w[REC_BYTES / 2];
+  memcpy(w, &r, REC_BYTES);
+  const uint16_t off = HDR_BYTES + _slot * REC_BYTES;
+  // i nepovedený zápis zabere slot (get() ho přeskočí jako vadný)
+  _slot++;
+  _used[_head] = _slot;
+  _flashCount++;
+  for (uint8_t k = 0; k < REC_BYTES / 2; k++) {
+    if (!_flash->program16(_head, off + k * 2, w[k])) return false;
+  }
+  return true;
+}
+
+void EventLog::readRecord(uint8_t p, uint16_t slot, BreakRecord& r) const {
+  uint16_t w[REC_BYTES / 2];
+  const uint16_t off = HDR_BYTES + slot * REC_BYTES;
+  for (uint8_t k = 0; k < REC_BYTES / 2; k++) w[k] = _flash->read16(p, off + k * 2);
+  memcpy(&r, w, REC_BYTES);
+}
+
+bool EventLog::add(const BreakRecord& r) {
+  if (_ramLen >= LOG_RAM_RECORDS) { _lost++; return false; }
+  _ram[_ramLen++] = r;
+  return true;
+}
+
+bool EventLog::flushDue(uint32_t nowMs, bool quiet) {
+  if (!_flash || !_ramLen) { _lastFlushMs = nowMs; return false; }
+  if (_ramLen >= LOG_RAM_RECORDS) return true;
+  if (!quiet) return false;
+  return _ramLen >= LOG_FLUSH_BATCH || (nowMs - _lastFlushMs) >= LOG_FLUSH_MS;
+}
+
+void EventLog::flush(uint32_t nowMs) {
+  for (uint8_t i = 0; i < _ramLen; i++) {
+    if (!writeRecord(_ram[i])) _lost++;
+  }
+  _ramLen = 0;
+  _lastFlushMs = nowMs;
+}
+
+void EventLog::clear() {
+  for (uint8_t p = 0; p < pages(); p++) {
+    if (p && _flash->read16(p, 0) != 0xFFFF) _flash->erase(p);
+    _used[p] = 0;
+  }
+  _flashCount = 0;
+  startPage(0, _seq + 1);
+  _ramLen = 0;
+  _lost = 0;
+}
+
+bool EventLog::get(uint32_t i, BreakRecord& r) const {
+  if (i >= _flashCount) {
+    i -= _flashCount;
+    if (i >= _ramLen) return false;
+    r = _ram[i];
+    return true;
+  }
+
+  // od nejstarší stránky (za _head) po _head
+  for (uint8_t k = 1; k <= pages(); k++) {
+    const uint8_t p = (uint8_t)((_head + k) % pages());
+    if (i < _used[p]) {
+      readRecord(p, (uint16_t)i, r);
+      // přerušený zápis má gate 0xFE (MARK_TORN); master loguje i brány slave
+      return r.gate != (uint8_t)MARK_TORN && r.gate < BUS_GATES;
+    }
+    i -= _used[p];
+  }
+  return false;
+}
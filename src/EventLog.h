@@ -0,0 +1,64 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "FlashIo.h"
+
+// Jedno přerušení brány (12 B, stejně v RAM i ve flash).
+struct BreakRecord {
+  uint32_t t;       // začátek, RTC sekundy (Rtc)
+  uint32_t durMs;   // délka přerušení
+  int16_t  peak;    // max. strength během přerušení
+  uint8_t  gate;
+  uint8_t  stage;   // dosažený stupeň 0..3 (>= COUNT_AT_MS => započítáno)
+};
+static_assert(sizeof(BreakRecord) == 12, "BreakRecord layout");
+
+// Záznam přerušení: loop() přidává do RAM fronty (add), do flash se píše
+// po dávkách (flushIfNeeded). Stránky ve flash tvoří kruh:
+//   hlavička {magic, seq32}, pak záznamy po 12 B.
+// Poslední půlslovo záznamu (gate|stage) se píše nakonec => 0xFFFF = volno,
+// přerušený zápis se přeskočí. Plná stránka => smazat nejstarší a pokračovat.
+// Čtení (get) jde přes flash i nezapsanou RAM frontu, index 0 = nejstarší.
+class EventLog {
+public:
+  void begin(FlashIo& flash);
+
+  // false = RAM fronta plná (záznam zahozen)
+  bool add(const BreakRecord& r);
+  // je čas zapsat? (dávka / LOG_FLUSH_MS); quiet = žádná brána není
+  // přerušená (mazání stránky zastaví CPU na ~20 ms). Plná fronta vždy.
+  bool flushDue(uint32_t nowMs, bool quiet);
+  void flush(uint32_t nowMs);
+  void clear();
+
+  uint32_t count() const { return _flashCount + _ramLen; }
+  uint16_t pending() const { return _ramLen; }
+  uint32_t lost() const { return _lost; }
+  bool get(uint32_t i, BreakRecord& r) const;
+
+private:
+  static const uint16_t MAGIC = 0xE10C;
+  static const uint16_t HDR_BYTES = 8;
+  static const uint16_t REC_BYTES = sizeof(BreakRecord);
+  static const uint8_t  MAX_PAGES = 8;
+
+  FlashIo* _flash = nullptr;
+  uint8_t  _head = 0;                // stránka, kam se píše
+  uint32_t _seq = 0;                 // seq stránky _head
+  uint16_t _used[MAX_PAGES] = {0};   // záznamů na stránce (0 = bez hlavičky)
+  uint16_t _slot = 0;                // další slot na _head
+  uint32_t _flashCount = 0;
+
+  BreakRecord _ram[LOG_RAM_RECORDS];
+  uint8_t  _ramLen = 0;
+  uint32_t _lastFlushMs = 0;
+  uint32_t _lost = 0;
+
+  uint8_t pages() const { return _flash->pageCount() < MAX_PAGES ? _flash->pageCount() : MAX_PAGES; }
+  uint16_t slotsPerPage() const { return (uint16_t)((_flash->pageSize() - HDR_BYTES) / REC_BYTES); }
+  bool pageValid(uint8_t p, uint32_t& seq) const;
+  void scanPage(uint8_t p);
+  bool startPage(uint8_t p, uint32_t seq);
+  bool writeRecord(const BreakRecord& r);
+  void readRecord(uint8_t p, uint16_t slot, BreakRecord& r) const;
+};
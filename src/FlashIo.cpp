@@ -0,0 +1,27 @@
+#include "FlashIo.h"
+
+#if IR_HW_STM32
+
+bool FlashStm32::program16(uint8_t page, uint16_t off, uint16_t v) {
+  if (page >= _pages) return false;
+  uint32_t addr = _base + (uint32_t)page * FLASH_PAGE_BYTES + off;
+  HAL_FLASH_Unlock();
+  HAL_StatusTypeDef st = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, addr, v);
+  HAL_FLASH_Lock();
+  return st == HAL_OK;
+}
+
+bool FlashStm32::erase(uint8_t page) {
+  if (page >= _pages) return false;
+  FLASH_EraseInitTypeDef e = {};
+  e.TypeErase = FLASH_TYPEERASE_PAGES;
+  e.PageAddress = _base + (uint32_t)page * FLASH_PAGE_BYTES;
+  e.NbPages = 1;
+  uint32_t err = 0;
+  HAL_FLASH_Unlock();
+  HAL_StatusTypeDef st = HAL_FLASHEx_Erase(&e, &err);
+  HAL_FLASH_Lock();
+  return st == HAL_OK;
+}
+
+#endif
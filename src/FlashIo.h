@@ -0,0 +1,74 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// Přístup ke stránkám flash pro žurnály (NOR sémantika jako F103:
+// mazání po stránkách na 0xFF, programování po půlslovech jen do 0xFFFF).
+class FlashIo {
+public:
+  virtual uint16_t pageSize() const = 0;
+  virtual uint8_t pageCount() const = 0;
+  virtual uint16_t read16(uint8_t page, uint16_t off) const = 0;
+  virtual bool program16(uint8_t page, uint16_t off, uint16_t v) = 0;
+  virtual bool erase(uint8_t page) = 0;
+
+  uint32_t read32(uint8_t page, uint16_t off) const {
+    return (uint32_t)read16(page, off) | ((uint32_t)read16(page, off + 2) << 16);
+  }
+};
+
+#if IR_HW_STM32
+// Skutečná flash F103 (HAL), stránky od baseAddr.
+class FlashStm32 : public FlashIo {
+public:
+  FlashStm32(uint32_t baseAddr, uint8_t pages) : _base(baseAddr), _pages(pages) {}
+
+  uint16_t pageSize() const override { return FLASH_PAGE_BYTES; }
+  uint8_t pageCount() const override { return _pages; }
+  uint16_t read16(uint8_t page, uint16_t off) const override {
+    return *(const volatile uint16_t*)(_base + (uint32_t)page * FLASH_PAGE_BYTES + off);
+  }
+  bool program16(uint8_t page, uint16_t off, uint16_t v) override;
+  bool erase(uint8_t page) override;
+
+private:
+  uint32_t _base;
+  uint8_t _pages;
+};
+#endif
+
+// Model flash v RAM (host / testy): stejná pravidla jako HW,
+// včetně odmítnutí programování nesmazaného půlslova.
+template <uint8_t PAGES, uint16_t PAGE_BYTES = FLASH_PAGE_BYTES>
+class FlashRam : public FlashIo {
+public:
+  FlashRam() { memset(_mem, 0xFF, sizeof(_mem)); }
+
+  uint16_t pageSize() const override { return PAGE_BYTES; }
+  uint8_t pageCount() const override { return PAGES; }
+  uint16_t read16(uint8_t page, uint16_t off) const override {
+    const uint8_t* m = &_mem[page][off];
+    return (uint16_t)(m[0] | (m[1] << 8));
+  }
+  bool program16(uint8_t page, uint16_t off, uint16_t v) override {
+    if (page >= PAGES || off + 2 > PAGE_BYTES || (off & 1)) return false;
+    if (read16(page, off) != 0xFFFF) return false;
+    _mem[page][off] = (uint8_t)v;
+    _mem[page][off + 1] = (uint8_t)(v >> 8);
+    programs++;
+    return true;
+  }
+  bool erase(uint8_t page) override {
+    if (page >= PAGES) return false;
+    memset(_mem[page], 0xFF, PAGE_BYTES);
+    erases++;
+    return true;
+  }
+
+  // statistika opotřebení
+  uint32_t programs = 0;
+  uint32_t erases = 0;
+
+private:
+  uint8_t _mem[PAGES][PAGE_BYTES];
+};
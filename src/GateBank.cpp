@@ -0,0 +1,251 @@
+#include "GateBank.h"
+
+// znaménko diff při přerušení: DIFF_INVERT volí zapojení tak, aby bez lock-in
+// bylo přerušení d > 0; v lock-in amplituda paprsku při přerušení klesá
+#if LOCKIN_ENABLE && DIFF_INVERT
+static const int32_t BREAK_SIGN = -1;
+#else
+static const int32_t BREAK_SIGN = 1;
+#endif
+
+void GateBank::begin(const volatile uint16_t* src) {
+  _src = src;
+  for (uint8_t i = 0; i < GATE_COUNT; i++) {
+    _base[i] = _src[i];
+    _baseFrac[i] = 0;
+    _diff[i] = 0;
+    _idle[i] = 0;
+    _strength[i] = 0;
+    _level[i] = 0;
+    _wN[i] = 0;
+    _nMeanQ4[i] = 0;
+    _nSigmaQ4[i] = 0;
+    _nMin[i] = _nMax[i] = 0;
+    _thr[i] = RUN_THR;
+  }
+  _noiseKnown = 0;
+  _idleSet = 0;
+  _zeroSet = 0;
+  _maxSet = 0;
+  _latch = 0;
+  _broken = 0;
+  _baseDiv = 0;
+  for (uint8_t i = 0; i < GATE_COUNT; i++) updateScale(i);
+  resetRun();
+}
+
+void GateBank::update() {
+  // baseline adaptace (jen BASE_UPDATE_HZ, ať časová konstanta nezávisí na SAMPLE_HZ)
+  bool adapt = false;
+  static const uint8_t BASE_DIV = (uint8_t)(SAMPLE_HZ / BASE_UPDATE_HZ);
+  _baseDiv = (uint8_t)(_baseDiv + _rateDiv);
+  if (_baseDiv >= BASE_DIV) { _baseDiv = (uint8_t)(_baseDiv - BASE_DIV); adapt = true; }
+
+  GateMask latch = _latch;
+  GateMask broken = 0;
+
+  for (uint8_t i = 0; i < GATE_COUNT; i++) {
+    const GateMask bit = 1UL << i;
+    int32_t v = _src[i];
+    int32_t base = _base[i];
+
+    // diff: buď v-base, nebo base-v (kvůli zapojení)
+#if DIFF_INVERT
+    int32_t d = v - base;
+#else
+    int32_t d = base - v;
+#endif
+
+    // Hystereze pro "rozbitý" stav
+    int32_t ad = (d < 0) ? -d : d;
+    if (latch & bit) { if (ad < (int32_t)DELTA_OFF) latch &= ~bit; }
+    else             { if (ad > (int32_t)DELTA_ON)  latch |= bit; }
+
+    // - v klidu pomalu sleduj prostředí
+    // - v "rozbitém" stavu baseline téměř neměň (jinak diff časem spadne na ~0)
+    // - signál na opačné straně než přerušení (návrat paprsku) => rychle dorovnat, jinak posun
+    //   nasbíraný během přerušení drží bránu "rozbitou" ještě desítky s a kolem
+    //   RUN_THR (< DELTA_OFF) pak strength kmitá
+    if (adapt) {
+      uint8_t shift;
+      if (d * BREAK_SIGN < -(int32_t)(RUN_THR / 2)) shift = (uint8_t)BASE_RETURN_SHIFT; // 1/4
+      else if (latch & bit)                         shift = (uint8_t)10;                // 1/1024
+      else                                          shift = (uint8_t)BASE_SHIFT;        // 1/64 default
+      // fixed point 14.16: (v - base) >> shift by pod 2^shift LSB nechalo baseline stát
+      int32_t q = (base << 16) | _baseFrac[i];
+      q += ((v << 16) - q) >> shift;
+      base = q >> 16;
+      _base[i] = (uint16_t)base;
+      _baseFrac[i] = (uint16_t)q;
+#if DIFF_INVERT
+      d = v - base;
+#else
+      d = base - v;
+#endif
+    }
+    _diff[i] = (int16_t)d;
+
+    // od ZERO (bez kalibrace idle, bez idle 0)
+    int32_t st = d - _ofs[i];
+    // úroveň v 0.1 %: jedno násobení (SMULL) a posun, dělení je v _scaleQ15;
+    // znaménko škály => kladná jen na straně přerušení – návrat paprsku
+    // s baseline ještě posunutou není přerušení (jinak záchvěvy kolem prahu)
+    int32_t lvl = (int32_t)(((int64_t)st * _scaleQ15[i]) >> 15);
+    const int32_t thr = _thrLvl[i];
+    if (lvl > thr) broken |= bit;
+    // šum (v LSB) jen v klidu; návrat po přerušení (velká výchylka) nepatří do šumu
+    else if (!(latch & bit) && lvl > -2 * thr) noiseSample(i, st * BREAK_SIGN);
+    if (lvl > INT16_MAX) lvl = INT16_MAX;
+    if (lvl < -INT16_MAX) lvl = -INT16_MAX;
+    _level[i] = (int16_t)lvl;
+    if (st < 0) st = -st;
+    _strength[i] = (int16_t)st;
+  }
+
+  _latch = latch;
+  _broken = broken;
+}
+
+void GateBank::noiseSample(uint8_t g, int32_t x) {
+  // Welford: mean += delta/n, M2 += delta*(x - mean_nový)
+  const int32_t x8 = x << 8;
+  const uint16_t n = ++_wN[g];
+  if (n == 1) {
+    _wMean[g] = x8;
+    _wM2[g] = 0;
+    _wMin[g] = _wMax[g] = (int16_t)x;
+  } else {
+    const int32_t delta = x8 - _wMean[g];
+    // zaokrouhlit: useknutí by se přes okno sčítalo do posunu průměru
+    _wMean[g] += (delta + (delta >= 0 ? (int32_t)(n / 2) : -(int32_t)(n / 2))) / n;
+    _wM2[g] += (int64_t)delta * (x8 - _wMean[g]);
+    if (x < _wMin[g]) _wMin[g] = (int16_t)x;
+    if (x > _wMax[g]) _wMax[g] = (int16_t)x;
+  }
+  if (n >= NOISE_WIN) noiseWindow(g);
+}
+
+static uint32_t isqrt32(uint32_t v) {
+  uint32_t r = 0, bit = 1UL << 30;
+  while (bit > v) bit >>= 2;
+  while (bit) {
+    if (v >= r + bit) { v -= r + bit; r = (r >> 1) + bit; }
+    else r >>= 1;
+    bit >>= 2;
+  }
+  return r;
+}
+
+void GateBank::noiseWindow(uint8_t g) {
+  // jednou za NOISE_WIN vzorků (~1 s) – sqrt se do ISR vejde
+  const uint16_t n = _wN[g];
+  _wN[g] = 0;
+  uint64_t var = (uint64_t)_wM2[g] / (uint32_t)(n - 1);   // Q16
+  if (var > 0xFFFFFFFFULL) var = 0xFFFFFFFFULL;
+  const uint32_t sigmaQ4 = isqrt32((uint32_t)var) >> 4;   // Q8 -> Q4
+  const int32_t meanQ4 = _wMean[g] >> 4;
+  const uint16_t sq4 = sigmaQ4 > 0xFFFF ? 0xFFFF : (uint16_t)sigmaQ4;
+
+  const GateMask bit = 1UL << g;
+  if (!(_noiseKnown & bit)) {
+    _noiseKnown |= bit;
+    _nMeanQ4[g] = meanQ4;
+    _nSigmaQ4[g] = sq4;
+  } else {
+    // přes okna 1/4 => práh neskáče s jedním neklidným oknem
+    _nMeanQ4[g] += (meanQ4 - _nMeanQ4[g]) / 4;
+    _nSigmaQ4[g] = (uint16_t)((int32_t)_nSigmaQ4[g] + ((int32_t)sq4 - (int32_t)_nSigmaQ4[g]) / 4);
+  }
+  _nMin[g] = _wMin[g];
+  _nMax[g] = _wMax[g];
+  updateThr(g);
+}
+
+void GateBank::updateThr(uint8_t g) {
+#if AUTO_THR_ENABLE
+  // do prvního okna (nebo sigma z kalibrace) platí RUN_THR
+  if ((_noiseKnown >> g) & 1UL) {
+    int32_t thr = (_nMeanQ4[g] + (int32_t)RUN_K_SIGMA * _nSigmaQ4[g] + 15) / 16;
+    if (thr < (int32_t)RUN_THR_MIN) thr = RUN_THR_MIN;
+    if (thr > (int32_t)RUN_THR_MAX) thr = RUN_THR_MAX;
+    _thr[g] = (uint16_t)thr;
+  }
+#endif
+  // do úrovně (nahoru); kalibrovaná brána nejméně RUN_THR_LEVEL
+  const int32_t sc = _scaleQ15[g] < 0 ? -_scaleQ15[g] : _scaleQ15[g];
+  int32_t lvl = (int32_t)(((int64_t)_thr[g] * sc + 32767) >> 15);
+  if (isCalibrated(g) && lvl < (int32_t)RUN_THR_LEVEL) lvl = RUN_THR_LEVEL;
+  if (lvl > INT16_MAX) lvl = INT16_MAX;
+  _thrLvl[g] = (int16_t)lvl;
+}
+
+void GateBank::updateScale(uint8_t g) {
+  const GateMask bit = 1UL << g;
+  const bool zero = _zeroSet & bit;
+  _ofs[g] = zero ? _zero[g] : (_idleSet & bit) ? _idle[g] : 0;
+
+  // MAX musí ležet od ZERO na straně přerušení, jinak výchozí rozpětí
+  int32_t span = (zero && (_maxSet & bit)) ? ((int32_t)_max[g] - _zero[g]) * BREAK_SIGN : 0;
+  if (span >= (int32_t)CAL_SPAN_MIN) _calOk |= bit;
+  else { _calOk &= ~bit; span = CAL_SPAN_DEFAULT; }
+  _scaleQ15[g] = BREAK_SIGN * (((int32_t)LEVEL_FULL << 15) / span);
+  updateThr(g);
+}
+
+void GateBank::setIdle(uint8_t g) {
+  _idle[g] = _diff[g];
+  _idleSet |= 1UL << g;
+  // signál nad idle se posunul => nové okno, průměr zase ~0
+  _wN[g] = 0;
+  _nMeanQ4[g] = 0;
+  updateScale(g);
+}
+
+void GateBank::setZero(uint8_t g) {
+  _zero[g] = _diff[g];
+  _zeroSet |= 1UL << g;
+  // ZERO má přednost před idle => posun jako u setIdle()
+  _wN[g] = 0;
+  _nMeanQ4[g] = 0;
+  updateScale(g);
+}
+
+void GateBank::setMax(uint8_t g) {
+  _max[g] = _diff[g];
+  _maxSet |= 1UL << g;
+  updateScale(g);
+}
+
+GateCal GateBank::exportCal(uint8_t g) const {
+  const GateMask bit = 1UL << g;
+  GateCal c;
+  c.idle = _idle[g];
+  c.zero = _zero[g];
+  c.max  = _max[g];
+  c.base = _base[g];
+  c.flags = CAL_BASE;
+  if (_idleSet & bit) c.flags |= CAL_IDLE;
+  if (_zeroSet & bit) c.flags |= CAL_ZERO;
+  if (_maxSet & bit)  c.flags |= CAL_MAX;
+  c.sigmaQ2 = 0;
+  if (_noiseKnown & bit) {
+    const uint16_t q2 = (uint16_t)((_nSigmaQ4[g] + 2) / 4);
+    c.sigmaQ2 = q2 > 255 ? 255 : q2 < 1 ? 1 : (uint8_t)q2;
+  }
+  return c;
+}
+
+void GateBank::importCal(uint8_t g, const GateCal& c) {
+  const GateMask bit = 1UL << g;
+  if (c.flags & CAL_IDLE) { _idle[g] = c.idle; _idleSet |= bit; }
+  if (c.flags & CAL_ZERO) { _zero[g] = c.zero; _zeroSet |= bit; }
+  if (c.flags & CAL_MAX)  { _max[g] = c.max;   _maxSet |= bit; }
+  if (c.flags & CAL_BASE) { _base[g] = c.base; _baseFrac[g] = 0; }
+  // práh hned ze šumu minulého běhu, okna ho pak doladí
+  if (c.sigmaQ2) {
+    _noiseKnown |= bit;
+    _nMeanQ4[g] = 0;
+    _nSigmaQ4[g] = (uint16_t)(c.sigmaQ2 * 4);
+  }
+  updateScale(g);
+}
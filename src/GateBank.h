@@ -0,0 +1,127 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// bit i = brána i
+typedef uint32_t GateMask;
+static_assert(GATE_COUNT <= 32, "GateMask ma jen 32 bitu");
+
+static const GateMask GATE_ALL = (GATE_COUNT >= 32) ? 0xFFFFFFFFUL : ((1UL << GATE_COUNT) - 1UL);
+
+// Kalibrace jedné brány (ukládá Storage, obnovuje se při startu)
+struct GateCal {
+  int16_t  idle;    // idle offset (setIdle)
+  int16_t  zero;    // ZERO bod (0 %), diff
+  int16_t  max;     // MAX bod (100 %), diff
+  uint16_t base;    // poslední ustálená baseline
+  uint8_t  flags;   // CAL_*
+  uint8_t  sigmaQ2; // šum v klidu (sigma, 1/4 LSB, saturuje), 0 = neznámý
+};
+static const uint8_t CAL_IDLE = 0x01;
+static const uint8_t CAL_ZERO = 0x02;
+static const uint8_t CAL_MAX  = 0x04;
+static const uint8_t CAL_BASE = 0x08;
+
+// Všechny brány najednou jako structure-of-arrays:
+// baseline, diff, idle, síla + stavové bity v maskách.
+// update() projde všechny kanály v jedné smyčce a nastaví brokenMask(),
+// ze které čte RUN vyhodnocení, UI i výpočet nejhoršího stupně.
+class GateBank {
+public:
+  // src = pole GATE_COUNT zdecimovaných vzorků (AdcScan::slot(0)),
+  // baseline z aktuálních hodnot
+  void begin(const volatile uint16_t* src);
+
+  // volat pořád (ISR) – všechny brány v jednom průchodu
+  void update();
+  // jeden update() = div vzorkovacích period (úsporný režim) => baseline se
+  // adaptuje stejně rychle v čase; okno šumu NOISE_WIN vzorků je div x delší
+  void setRateDiv(uint8_t div) { _rateDiv = div; }
+
+  // DIAG (z loop() volat s vypnutými přerušeními, mění stav čtený ISR)
+  void setIdle(uint8_t g);              // 3× klik
+  bool hasIdleSet(uint8_t g) const { return (_idleSet >> g) & 1UL; }
+  void setZero(uint8_t g);              // ZERO (0 %) = aktuální diff
+  void setMax(uint8_t g);               // MAX (100 %) = aktuální diff
+  // platná dvojice ZERO/MAX (MAX na straně přerušení, rozpětí >= CAL_SPAN_MIN)
+  bool isCalibrated(uint8_t g) const { return (_calOk >> g) & 1UL; }
+
+  // kalibrace pro Storage; importCal() nastaví i baseline => detekce
+  // funguje od prvního vzorku po startu (volat s vypnutými přerušeními)
+  GateCal exportCal(uint8_t g) const;
+  void importCal(uint8_t g, const GateCal& c);
+  // brána je v klidu => baseline je ustálená a dá se uložit
+  bool isSettled(uint8_t g) const { return !((_latch >> g) & 1UL); }
+  int16_t diff(uint8_t g) const { return _diff[g]; }
+  int16_t strength(uint8_t g) const { return _strength[g]; }
+  // úroveň na straně přerušení v 0.1 % (LEVEL_FULL = MAX) a RUN práh v ní
+  int16_t level(uint8_t g) const { return _level[g]; }
+  int16_t levelThr(uint8_t g) const { return _thrLvl[g]; }
+  uint16_t base(uint8_t g) const { return _base[g]; }
+  uint16_t value(uint8_t g) const { return _src[g]; }
+
+  // šum v klidu (poslední okna NOISE_WIN) a z něj odvozený RUN práh
+  int16_t noiseMean(uint8_t g) const { return (int16_t)(_nMeanQ4[g] / 16); }
+  uint16_t noiseSigmaQ4(uint8_t g) const { return _nSigmaQ4[g]; } // 1/16 LSB
+  uint16_t noisePp(uint8_t g) const { return (uint16_t)(_nMax[g] - _nMin[g]); }
+  uint16_t runThr(uint8_t g) const { return _thr[g]; }
+
+  // RUN: úroveň > levelThr()
+  GateMask brokenMask() const { return _broken; }
+  bool isBroken(uint8_t g) const { return (_broken >> g) & 1UL; }
+
+  // --- RUN stav přerušení (mění jen Sampler v ISR) ---
+  GateMask interrupted = 0;          // právě přerušené
+  GateMask counted = 0;              // už započítané (do návratu signálu)
+  uint32_t sinceUs[GATE_COUNT] = {0}; // začátek přerušení (čas vzorkovače, us; z AWD přesně)
+  int16_t  peak[GATE_COUNT] = {0};    // max. strength během přerušení (záznam událostí)
+
+  void resetRun() { interrupted = 0; counted = 0; }
+
+private:
+  const volatile uint16_t* _src = nullptr;
+
+  uint16_t _base[GATE_COUNT] = {0};
+  uint16_t _baseFrac[GATE_COUNT] = {0}; // zlomek baseline (1/65536 LSB) – bez něj mrtvé pásmo 2^shift LSB
+  int16_t  _diff[GATE_COUNT] = {0};
+  int16_t  _idle[GATE_COUNT] = {0};
+  int16_t  _strength[GATE_COUNT] = {0};
+  int16_t  _zero[GATE_COUNT] = {0};
+  int16_t  _max[GATE_COUNT] = {0};
+  // úroveň = ((diff - _ofs) * _scaleQ15) >> 15; _scaleQ15 = ±LEVEL_FULL/rozpětí
+  // v Q15 (znaménko = strana přerušení), počítá updateScale() mimo ISR
+  int16_t  _ofs[GATE_COUNT] = {0};
+  int32_t  _scaleQ15[GATE_COUNT] = {0};
+  int16_t  _level[GATE_COUNT] = {0};
+
+  GateMask _idleSet = 0;
+  GateMask _zeroSet = 0;
+  GateMask _maxSet = 0;
+  GateMask _calOk = 0;
+  // hysterese: když je brána "rozbitá", nechceme aby baseline utekla k nové hodnotě
+  GateMask _latch = 0;
+  GateMask _broken = 0;
+
+  uint8_t _baseDiv = 0;   // baseline jen každý N-tý vzorek (BASE_UPDATE_HZ)
+  volatile uint8_t _rateDiv = 1;
+
+  // Welford v okně: průměr Q8, M2 Q16
+  uint16_t _wN[GATE_COUNT] = {0};
+  int32_t  _wMean[GATE_COUNT] = {0};
+  int64_t  _wM2[GATE_COUNT] = {0};
+  int16_t  _wMin[GATE_COUNT] = {0};
+  int16_t  _wMax[GATE_COUNT] = {0};
+  // výsledek (vyhlazený přes okna)
+  int32_t  _nMeanQ4[GATE_COUNT] = {0};
+  uint16_t _nSigmaQ4[GATE_COUNT] = {0};
+  int16_t  _nMin[GATE_COUNT] = {0};
+  int16_t  _nMax[GATE_COUNT] = {0};
+  uint16_t _thr[GATE_COUNT] = {0};      // LSB (ze šumu)
+  int16_t  _thrLvl[GATE_COUNT] = {0};   // 0.1 %
+  GateMask _noiseKnown = 0;
+
+  void noiseSample(uint8_t g, int32_t x);
+  void noiseWindow(uint8_t g);
+  void updateThr(uint8_t g);
+  void updateScale(uint8_t g);
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include <Arduino.h>
+#include <math.h>
+#include "config.h"
+#include "MuxScan.h"
+
+#if MUX_ENABLE
+
+// Model multiplexerů pro host simulaci (SignalSim): přehrává DMA tabulky
+// MuxScan do virtuálního GPIOB->ODR v časech událostí TIM3 a počítá napětí
+// na COM každého muxu jako RC přechod z hodnoty v okamžiku přepnutí:
+//   v(t) = L + (v_sw - L) * exp(-(t - t_sw) / tau),  L = ustálená úroveň brány
+// Vzorek se bere na konci vzorkování vstupu (MuxScan::sampleEndNs).
+// Hlídá, že vzorek patří bráně, kterou čeká decimace (adresa = sken % MUX_WAYS)
+// a jak daleko od ustálené hodnoty byl (max. chyba v LSB 12 bit).
+// Pouze header – do firmware se dostane jen když ho někdo includuje.
+class MuxModel {
+public:
+  // pull-up 45k x (COM muxu + S/H ADC ~40 pF)
+  float tauNs = 1800.0f;
+
+  // jeden sken: level = ustálené úrovně všech bran, out = vzorky vstupů ADC
+  void scan(const float level[GATE_COUNT], float out[ADC_INPUTS]) {
+    const uint8_t idx = (uint8_t)(_scans % MUX_WAYS);
+    if (_scans == 0) {
+      for (uint8_t m = 0; m < MUX_COUNT; m++) {
+        _com[m].gate = (uint8_t)(m * MUX_WAYS);
+        _com[m].v = level[_com[m].gate];
+        _com[m].tSw = 0;
+      }
+    }
+
+    // update: skupina 1 na adresu tohoto skenu
+    if (MuxScan::SPLIT) apply(_sched.bsrr(1, idx), _t0, level);
+    for (uint8_t k = 0; k < ADC_INPUTS; k++) {
+      const uint64_t t = _t0 + MuxScan::sampleEndNs(k);
+      const float v = at(k, t, level);
+      const uint8_t want = (uint8_t)(k * MUX_WAYS + idx);
+      if (_com[k].gate != want) _addrErrors++;
+      const float err = fabsf(v - level[want]);
+      if (err > _maxErr) _maxErr = err;
+      out[k] = v;
+    }
+    // CC3: skupina 0 na adresu příštího skenu
+    apply(_sched.bsrr(0, idx), _t0 + MuxScan::switchNs(), level);
+
+    _t0 += MuxScan::periodNs();
+    _scans++;
+  }
+
+  float maxErr() const { return _maxErr; }
+  uint32_t addrErrors() const { return _addrErrors; }
+  uint64_t scans() const { return _scans; }
+
+private:
+  struct Com {
+    uint8_t gate;   // připojená brána
+    float v;        // napětí COM v okamžiku přepnutí
+    uint64_t tSw;   // ns
+  };
+
+  float at(uint8_t m, uint64_t t, const float level[GATE_COUNT]) const {
+    const Com& c = _com[m];
+    const float l = level[c.gate];
+    return l + (c.v - l) * expf(-(float)(t - c.tSw) / tauNs);
+  }
+
+  // zápis do BSRR; mux se přepne, jen když se změnila adresa jeho skupiny
+  void apply(uint32_t bsrr, uint64_t t, const float level[GATE_COUNT]) {
+    _odr = (uint16_t)((_odr & ~(bsrr >> 16)) | (bsrr & 0xFFFF));
+    for (uint8_t m = 0; m < MUX_COUNT; m++) {
+      const uint8_t addr = _sched.decode(MuxScan::groupOf(m), _odr);
+      const uint8_t gate = (uint8_t)(m * MUX_WAYS + addr);
+      if (gate == _com[m].gate) continue;
+      _com[m].v = at(m, t, level);
+      _com[m].tSw = t;
+      _com[m].gate = gate;
+    }
+  }
+
+  MuxScan _sched;
+  Com _com[MUX_COUNT];
+  uint16_t _odr = 0;   // obě skupiny na adrese 0 (MuxScan::begin)
+  uint64_t _t0 = 0;    // ns, začátek skenu
+  uint64_t _scans = 0;
+  float _maxErr = 0.0f;
+  uint32_t _addrErrors = 0;
+};
+
+#endif
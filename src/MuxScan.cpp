@@ -0,0 +1,86 @@
+#include "MuxScan.h"
+
+#if MUX_ENABLE
+
+static_assert(MUX_WAYS == 8 || MUX_WAYS == 16, "CD4051 (8) nebo CD4067 (16)");
+static_assert(MUX_GROUP0 >= 1 && MUX_GROUP0 <= MUX_COUNT, "skupina 0 musi mit aspon 1 mux");
+static_assert((uint32_t)ADC_SLOTS * MuxScan::convNs() <= MuxScan::periodNs(),
+              "sken vsech COM se nevejde do periody TIM3");
+static_assert(MuxScan::switchNs() < MuxScan::periodNs(), "CC3 za koncem periody");
+
+static uint8_t gpioBit(uint8_t pin) {
+#if IR_HW_STM32
+  return (uint8_t)STM_PIN(digitalPinToPinName(pin));
+#else
+  return (uint8_t)(pin & 15); // sim: PBx = 16 + x
+#endif
+}
+
+MuxScan::MuxScan() {
+  for (uint8_t g = 0; g < GROUPS; g++) {
+    for (uint8_t b = 0; b < SEL_BITS; b++) _bit[g][b] = gpioBit(MUX_SEL_PINS[g][b]);
+  }
+  // skupina 1 se přepíná na startu skenu i => adresa i;
+  // skupina 0 uprostřed skenu i => adresa příštího skenu
+  // (bez SPLIT nese slovo skupiny 0 i vodiče skupiny 1)
+  for (uint8_t i = 0; i < MUX_WAYS; i++) {
+    _bsrr[0][i] = word(0, (uint8_t)((i + 1) % MUX_WAYS));
+    _bsrr[1][i] = word(1, i);
+    if (!SPLIT) _bsrr[0][i] |= word(1, (uint8_t)((i + 1) % MUX_WAYS));
+  }
+}
+
+uint32_t MuxScan::word(uint8_t g, uint8_t addr) const {
+  uint32_t w = 0;
+  for (uint8_t b = 0; b < SEL_BITS; b++) {
+    w |= ((addr >> b) & 1) ? 1UL << _bit[g][b] : 1UL << (_bit[g][b] + 16);
+  }
+  return w;
+}
+
+uint8_t MuxScan::decode(uint8_t g, uint16_t odr) const {
+  uint8_t a = 0;
+  for (uint8_t b = 0; b < SEL_BITS; b++) a |= (uint8_t)(((odr >> _bit[g][b]) & 1) << b);
+  return a;
+}
+
+#if IR_HW_STM32
+
+void MuxScan::begin(TIM_TypeDef* t) {
+  RCC->APB2ENR |= RCC_APB2ENR_AFIOEN | RCC_APB2ENR_IOPBEN;
+  RCC->AHBENR  |= RCC_AHBENR_DMA1EN;
+  __HAL_AFIO_REMAP_SWJ_NOJTAG(); // PB3/PB4 jako GPIO, SWD zůstává
+
+  // obě skupiny na adrese 0 = první sken
+  for (uint8_t g = 0; g < GROUPS; g++) {
+    for (uint8_t b = 0; b < SEL_BITS; b++) {
+      pinMode(MUX_SEL_PINS[g][b], OUTPUT);
+      digitalWrite(MUX_SEL_PINS[g][b], LOW);
+    }
+  }
+
+  // DMA1 Ch2 = TIM3_CH3 (skupina 0), Ch3 = TIM3_UP (skupina 1);
+  // paměť -> GPIOB->BSRR, 32 bit, kruhově, bez přerušení
+  DMA_Channel_TypeDef* const ch[GROUPS] = { DMA1_Channel2, DMA1_Channel3 };
+  for (uint8_t g = 0; g < GROUPS; g++) {
+    ch[g]->CCR   = 0;
+    ch[g]->CPAR  = (uint32_t)&GPIOB->BSRR;
+    ch[g]->CMAR  = (uint32_t)_bsrr[g];
+    ch[g]->CNDTR = MUX_WAYS;
+    ch[g]->CCR   = DMA_CCR_DIR | DMA_CCR_MINC | DMA_CCR_CIRC
+                 | DMA_CCR_PSIZE_1 | DMA_CCR_MSIZE_1 | DMA_CCR_PL_1;
+    if (g == 1 && !SPLIT) continue; // skupinu 1 přepíná slovo skupiny 0
+    ch[g]->CCR  |= DMA_CCR_EN;
+  }
+
+  // CC3 (frozen, jen DMA požadavek) po vzorkování skupiny 0
+  const uint32_t arr = t->ARR + 1;
+  t->CCR3  = (uint32_t)((uint64_t)arr * switchNs() / periodNs());
+  t->DIER |= TIM_DIER_CC3DE | (SPLIT ? TIM_DIER_UDE : 0);
+  // čítač za CCR3 => první událost je update (sken 0), CC3 až po ní
+  t->CNT   = t->CCR3 + 1;
+}
+
+#endif
+
+#endif
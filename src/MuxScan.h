@@ -0,0 +1,73 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+#if MUX_ENABLE
+
+// Plánovač adres analogových multiplexerů (MUX_ENABLE).
+// Sken s (0..ADC_SCANS-1) převádí COM všech muxů v pořadí ADC_CH, všechny
+// na adrese s % MUX_WAYS. Přepnutí muxu + ustálení COM (pull-up 45k a
+// kapacita COM) by z periody skenu ubralo několik us, proto jsou muxy ve
+// dvou skupinách s vlastními adresními vodiči a přepínají se střídavě:
+//   TIM3 update (start skenu s)      -> DMA1 Ch3: skupina 1 na adresu s,
+//                                      ustálí se během převodů skupiny 0
+//   TIM3 CC3 (po vzorkování skupiny 0) -> DMA1 Ch2: skupina 0 na adresu s+1,
+//                                      ustálí se během skupiny 1 a zbytku periody
+// Obě DMA zapisují kruhově tabulky slov GPIOB->BSRR, CPU do toho nesahá.
+// DUAL_ADC_ENABLE: COM obou skupin se vzorkují ve stejném slotu => není co
+// překrývat; CC3 po posledním slotu přepne obě skupiny jedním slovem a
+// ustálení má celou zbývající periodu (DMA1 Ch3 stojí).
+// Časy skenu sdílí host model (MuxModel.h), který tabulky "přehrává".
+class MuxScan {
+public:
+  static const uint8_t GROUPS = 2;
+  static const uint8_t SEL_BITS = MUX_WAYS == 16 ? 4 : 3;
+  static const uint32_t ADC_CLK_HZ = 12000000UL; // PCLK2/6 (AdcScan)
+  // skupina 1 má vlastní DMA na update (jinak ji přepíná slovo skupiny 0)
+  static const bool SPLIT = !DUAL_ADC_ENABLE && MUX_GROUP0 < MUX_COUNT;
+
+  MuxScan();
+
+#if IR_HW_STM32
+  // adresní vodiče, SWJ remap, DMA1 Ch2/Ch3, TIM3 CC3 + DMA požadavky;
+  // volá AdcScan::begin() před spuštěním TIM3
+  void begin(TIM_TypeDef* t);
+#endif
+
+  // slovo BSRR, které zapíše DMA skupiny g v i-tém skenu periody MUX_WAYS
+  uint32_t bsrr(uint8_t g, uint8_t i) const { return _bsrr[g][i]; }
+  // adresa skupiny g podle stavu výstupů GPIOB
+  uint8_t decode(uint8_t g, uint16_t odr) const;
+  static uint8_t groupOf(uint8_t mux) { return mux < MUX_GROUP0 ? 0 : 1; }
+
+  // časování skenu v ns od události update (start skenu)
+  static constexpr uint32_t periodNs() { return 1000000000UL / ((uint32_t)SAMPLE_HZ * ADC_SCANS); }
+  static constexpr uint32_t sampleNs() { return smpHalfCycles() * 500000000UL / ADC_CLK_HZ; }
+  static constexpr uint32_t convNs() { return (smpHalfCycles() + 25) * 500000000UL / ADC_CLK_HZ; }
+  // konec vzorkování vstupu k (pak už je napětí v S/H kondenzátoru);
+  // s dual ADC jsou vstupy 2j a 2j+1 ve stejném slotu j
+  static constexpr uint32_t sampleEndNs(uint8_t k) { return (k / ADC_PARALLEL) * convNs() + sampleNs(); }
+  // CC3: přepnutí skupiny 0 (bez SPLIT všech muxů)
+  static constexpr uint32_t switchNs() {
+    return sampleEndNs(SPLIT ? MUX_GROUP0 - 1 : ADC_INPUTS - 1) + MUX_GUARD_NS;
+  }
+  // doba od přepnutí skupiny do konce vzorkování jejího prvního muxu
+  static constexpr uint32_t settleNs(uint8_t g) {
+    return g == 0 || !SPLIT ? periodNs() - switchNs() + sampleNs() : sampleEndNs(MUX_GROUP0);
+  }
+
+private:
+  // SMPR kód -> 2x počet cyklů vzorkování (1.5, 7.5, ... 239.5)
+  static constexpr uint32_t smpHalfCycles() {
+    return ADC_SMP_CODE == 0 ? 3 : ADC_SMP_CODE == 1 ? 15 : ADC_SMP_CODE == 2 ? 27 :
+           ADC_SMP_CODE == 3 ? 57 : ADC_SMP_CODE == 4 ? 83 : ADC_SMP_CODE == 5 ? 111 :
+           ADC_SMP_CODE == 6 ? 143 : 479;
+  }
+
+  uint32_t word(uint8_t g, uint8_t addr) const;
+
+  uint32_t _bsrr[GROUPS][MUX_WAYS];
+  uint8_t _bit[GROUPS][SEL_BITS];   // bit GPIOB adresního vodiče
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "Power.h"
+#include "Dwt.h"
+
+Power power;
+
+static const char* const NAMES[(uint8_t)PowerMode::Count] = { "arm", "idle", "diag" };
+
+void Power::begin() {
+  _lastUs = micros();
+  _lastCyc = dwtCycles();
+  _activityMs = millis();
+}
+
+void Power::idle(bool sleep) {
+  const uint32_t us = micros();
+  const uint32_t cyc = dwtCycles();
+  Stat& s = _stat[(uint8_t)_mode];
+
+  // CYCCNT přeteče po ~59 s, průchod loop() je o řády kratší
+  const uint32_t dt = us - _lastUs;
+  uint32_t act = dwtCyclesToUs(cyc - _lastCyc);
+  if (act > dt) act = dt;
+  s.totalUs += dt;
+  s.activeUs += act;
+  _lastUs = us;
+  _lastCyc = cyc;
+
+#if POWER_SAVE_ENABLE
+  if (!sleep) return;
+  s.wakeups++;
+#if IR_HW_STM32
+  // přerušení mezi posledním testem v loop() a WFI => zpoždění nejvýš do
+  // dalšího přerušení (SysTick 1 ms, dávka ADC)
+  __DSB();
+  __WFI();
+#endif
+#else
+  (void)sleep;
+#endif
+}
+
+void Power::reset() {
+  noInterrupts();
+  for (uint8_t i = 0; i < (uint8_t)PowerMode::Count; i++) _stat[i] = Stat();
+  interrupts();
+}
+
+void Power::dump(Print& out) const {
+  out.println("rezim\tcas [s]\taktivni [%]\tprobuzeni/s\t~mA (MCU)");
+  for (uint8_t i = 0; i < (uint8_t)PowerMode::Count; i++) {
+    const Stat& s = _stat[i];
+    char line[64];
+    if (!s.totalUs) {
+      snprintf(line, sizeof(line), "%s\t0", NAMES[i]);
+      out.println(line);
+      continue;
+    }
+    const uint32_t ms = (uint32_t)(s.totalUs / 1000ULL);
+    const uint32_t actPm = (uint32_t)(s.activeUs * 1000ULL / s.totalUs); // promile
+    const uint32_t wakeHz = (uint32_t)((uint64_t)s.wakeups * 1000000ULL / s.totalUs);
+    const uint32_t ma10 = (POWER_RUN_MA * actPm + POWER_SLEEP_MA * (1000 - actPm)) / 100;
+    snprintf(line, sizeof(line), "%s\t%lu.%lu\t%lu.%lu\t%lu\t%lu.%lu",
+             NAMES[i], (unsigned long)(ms / 1000), (unsigned long)(ms % 1000 / 100),
+             (unsigned long)(actPm / 10), (unsigned long)(actPm % 10), (unsigned long)wakeHz,
+             (unsigned long)(ma10 / 10), (unsigned long)(ma10 % 10));
+    out.println(line);
+  }
+}
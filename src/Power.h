@@ -0,0 +1,54 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// Úsporný režim: jádro spí (WFI, Sleep mode – periferie, DMA a časovače
+// běží dál) mezi průchody loop(), které vzbudí kterékoli přerušení
+// (i EXTI tlačítek, Buttons.h). Čas se účtuje podle režimu: celkem z micros(),
+// aktivní z DWT CYCCNT (ve spánku stojí, obsluhy přerušení započítá) =>
+// spánek = rozdíl. Host: WFI nic nedělá, vše aktivní.
+enum class PowerMode : uint8_t {
+  Armed = 0,  // RUN s ARM (plná SAMPLE_HZ)
+  Idle,       // RUN bez ARM (SAMPLE_HZ/IDLE_RATE_DIV)
+  Diag,
+  Count
+};
+
+class Power {
+public:
+  // po AdcScan::begin() (DWT už běží)
+  void begin();
+
+  // účtování od příštího průchodu
+  void setMode(PowerMode m) { _mode = m; }
+
+  // začátek loop(): předchozí průchod do statistiky, pak spát do příštího
+  // přerušení (sleep=false nebo POWER_SAVE_ENABLE=0 => jen účtovat)
+  void idle(bool sleep);
+
+  // nečinnost pro zhasnutí OLED
+  void activity(uint32_t nowMs) { _activityMs = nowMs; }
+  bool inactive(uint32_t nowMs) const { return (uint32_t)(nowMs - _activityMs) >= OLED_SLEEP_MS; }
+
+  uint64_t totalUs(PowerMode m) const { return _stat[(uint8_t)m].totalUs; }
+  uint64_t activeUs(PowerMode m) const { return _stat[(uint8_t)m].activeUs; }
+
+  void reset();
+  // čas, aktivní/spánek, probuzení a odhad proudu MCU po režimech
+  void dump(Print& out) const;
+
+private:
+  struct Stat {
+    uint64_t totalUs = 0;
+    uint64_t activeUs = 0;
+    uint32_t wakeups = 0;
+  };
+
+  Stat _stat[(uint8_t)PowerMode::Count];
+  PowerMode _mode = PowerMode::Idle;
+  uint32_t _lastUs = 0;
+  uint32_t _lastCyc = 0;
+  uint32_t _activityMs = 0;
+};
+
+extern Power power;
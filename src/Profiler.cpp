@@ -0,0 +1,65 @@
+#include "Profiler.h"
+
+Profiler profiler;
+
+static const char* const NAMES[(uint8_t)Prof::Count] = {
+  "loop", "btn", "evt", "snd", "sto", "ui", "tele", "bus", "isr"
+};
+
+const char* Profiler::name(Prof stage) { return NAMES[(uint8_t)stage]; }
+
+void Profiler::loopMark() {
+#if PROFILER_ENABLE
+  const uint32_t now = dwtCycles();
+  if (_haveLoop) {
+    const uint32_t cyc = now - _lastLoopCyc;
+    add(Prof::Loop, cyc);
+    _period.add(dwtCyclesToUs(cyc));
+  }
+  _lastLoopCyc = now;
+  _haveLoop = true;
+#endif
+}
+
+void Profiler::reset() {
+  // ISR úsek píše DMA přerušení => nulovat bez něj
+  noInterrupts();
+  for (uint8_t i = 0; i < (uint8_t)Prof::Count; i++) _stat[i] = ProfStat();
+  interrupts();
+  _latStat = ProfStat();
+  _period.reset();
+  _latency.reset();
+  _haveLoop = false;
+}
+
+static void printHist(Print& out, const char* title, const LogHist& h) {
+  out.print(title);
+  out.println(" [us]:");
+  for (uint8_t k = 0; k < LogHist::BUCKETS; k++) {
+    if (!h.count(k)) continue;
+    out.print(k == LogHist::BUCKETS - 1 ? "  >=" : "  <");
+    out.print(k == LogHist::BUCKETS - 1 ? LogHist::upperUs(k - 1) : LogHist::upperUs(k));
+    out.print(": ");
+    out.println(h.count(k));
+  }
+}
+
+static void printStat(Print& out, const char* name, const ProfStat& s) {
+  out.print(name);
+  out.print('\t');
+  out.print(s.n);
+  out.print('\t');
+  out.print(s.minUs());
+  out.print('\t');
+  out.print(s.avgUs());
+  out.print('\t');
+  out.println(s.maxUs());
+}
+
+void Profiler::dump(Print& out) const {
+  out.println("usek\tn\tmin\tavg\tmax [us]");
+  for (uint8_t i = 0; i < (uint8_t)Prof::Count; i++) printStat(out, NAMES[i], _stat[i]);
+  printStat(out, "lat", _latStat);
+  printHist(out, "perioda loop", _period);
+  printHist(out, "latence preruseni", _latency);
+}
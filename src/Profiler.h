@@ -0,0 +1,106 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "Dwt.h"
+
+// Měření úseků loop() a ISR cyklovým čítačem DWT (13.9 ns).
+// Na úsek (jedno měření = jedno volání): počet, min/průměr/max. Histogramy (log2 us): perioda loop()
+// a latence přerušení paprsku -> zpracování v loop().
+// PROF_SCOPE(stage) změří zbytek bloku; PROFILER_ENABLE=0 => nic.
+enum class Prof : uint8_t {
+  Loop = 0,  // celá perioda loop()
+  Buttons,   // tlačítka + sekvence
+  Events,    // fronta událostí vzorkovače
+  Sound,     // Buzzer::service/tick
+  Storage,   // žurnál + kalibrace
+  Ui,        // UiOled::draw
+  Tele,      // Telemetry::service (kódování + TX)
+  Bus,       // Bus::service (sběrnice řadičů)
+  AdcIsr,    // DMA dávka: decimace + Sampler::onTick
+  Count
+};
+
+// histogram po mocninách 2: bucket k = [2^(k-1), 2^k) us, 0 = 0 us
+class LogHist {
+public:
+  static const uint8_t BUCKETS = 16;
+
+  void add(uint32_t us) {
+    uint8_t k = us ? (uint8_t)(32 - __builtin_clz(us)) : 0;
+    if (k >= BUCKETS) k = BUCKETS - 1;
+    _n[k]++;
+  }
+  uint32_t count(uint8_t k) const { return _n[k]; }
+  // horní mez bucketu (us); poslední je otevřený
+  static uint32_t upperUs(uint8_t k) { return 1UL << k; }
+  void reset() { memset(_n, 0, sizeof(_n)); }
+
+private:
+  uint32_t _n[BUCKETS] = {0};
+};
+
+struct ProfStat {
+  uint32_t n = 0;
+  uint32_t minCyc = 0xFFFFFFFFUL;
+  uint32_t maxCyc = 0;
+  uint64_t sumCyc = 0;
+
+  void add(uint32_t cyc) {
+    n++;
+    sumCyc += cyc;
+    if (cyc < minCyc) minCyc = cyc;
+    if (cyc > maxCyc) maxCyc = cyc;
+  }
+  uint32_t minUs() const { return n ? dwtCyclesToUs(minCyc) : 0; }
+  uint32_t avgUs() const { return n ? dwtCyclesToUs((uint32_t)(sumCyc / n)) : 0; }
+  uint32_t maxUs() const { return dwtCyclesToUs(maxCyc); }
+};
+
+class Profiler {
+public:
+  void add(Prof stage, uint32_t cycles) { _stat[(uint8_t)stage].add(cycles); }
+
+  // na začátku každého loop() – perioda od minulého volání
+  void loopMark();
+  // přerušení paprsku (začátek z AWD) -> událost zpracovaná v loop()
+  void addLatencyUs(uint32_t us) { _latency.add(us); _latStat.add(us * CPU_MHZ); }
+
+  const ProfStat& stat(Prof stage) const { return _stat[(uint8_t)stage]; }
+  const ProfStat& latency() const { return _latStat; }
+  const LogHist& periodHist() const { return _period; }
+  const LogHist& latencyHist() const { return _latency; }
+  static const char* name(Prof stage);
+
+  void reset();
+  void dump(Print& out) const;
+
+private:
+  ProfStat _stat[(uint8_t)Prof::Count];
+  ProfStat _latStat;
+  LogHist _period;
+  LogHist _latency;
+  uint32_t _lastLoopCyc = 0;
+  bool _haveLoop = false;
+};
+
+extern Profiler profiler;
+
+#if PROFILER_ENABLE
+class ProfScope {
+public:
+  explicit ProfScope(Prof stage) : _stage(stage), _t0(dwtCycles()) {}
+  ~ProfScope() { profiler.add(_stage, dwtCycles() - _t0); }
+
+private:
+  Prof _stage;
+  uint32_t _t0;
+};
+  #define PROF_SCOPE(stage) ProfScope _profScope(stage)
+  // úsek přes víc příkazů bez vlastního bloku
+  #define PROF_START(t0) const uint32_t t0 = dwtCycles()
+  #define PROF_STOP(stage, t0) profiler.add(stage, dwtCycles() - (t0))
+#else
+  #define PROF_SCOPE(stage) do {} while (0)
+  #define PROF_START(t0) do {} while (0)
+  #define PROF_STOP(stage, t0) do {} while (0)
+#endif
@@ -0,0 +1,86 @@
+#include "Rtc.h"
+
+Rtc rtc;
+
+#if IR_HW_STM32
+static void rtcWaitWrite() { while (!(RTC->CRL & RTC_CRL_RTOFF)) {} }
+
+void Rtc::begin() {
+  RCC->APB1ENR |= RCC_APB1ENR_PWREN | RCC_APB1ENR_BKPEN;
+  PWR->CR |= PWR_CR_DBP;
+
+  if (!(RCC->BDCR & RCC_BDCR_RTCEN)) {
+    // první start (nebo po odpojení VBAT): zdroj + dělička na 1 Hz
+    uint32_t prl = 32767;
+    RCC->BDCR |= RCC_BDCR_LSEON;
+    uint32_t t0 = millis();
+    while (!(RCC->BDCR & RCC_BDCR_LSERDY) && (millis() - t0) < 1500) {}
+    if (RCC->BDCR & RCC_BDCR_LSERDY) {
+      RCC->BDCR |= RCC_BDCR_RTCSEL_LSE;
+    } else {
+      RCC->BDCR &= ~RCC_BDCR_LSEON;
+      RCC->CSR |= RCC_CSR_LSION;
+      while (!(RCC->CSR & RCC_CSR_LSIRDY)) {}
+      RCC->BDCR |= RCC_BDCR_RTCSEL_LSI;
+      prl = 39999;
+    }
+    RCC->BDCR |= RCC_BDCR_RTCEN;
+
+    rtcWaitWrite();
+    RTC->CRL |= RTC_CRL_CNF;
+    RTC->PRLH = prl >> 16;
+    RTC->PRLL = prl & 0xFFFF;
+    RTC->CRL &= ~RTC_CRL_CNF;
+    rtcWaitWrite();
+  }
+
+  // po resetu počkat na synchronizaci registrů s doménou RTC
+  RTC->CRL &= ~RTC_CRL_RSF;
+  while (!(RTC->CRL & RTC_CRL_RSF)) {}
+}
+
+uint32_t Rtc::now() const {
+  // CNTH/CNTL nejsou atomické => přečíst znovu, když se horní půlka změnila
+  uint16_t hi, lo;
+  do {
+    hi = RTC->CNTH;
+    lo = RTC->CNTL;
+  } while (hi != RTC->CNTH);
+  return ((uint32_t)hi << 16) | lo;
+}
+
+void Rtc::set(uint32_t unixTime) {
+  rtcWaitWrite();
+  RTC->CRL |= RTC_CRL_CNF;
+  RTC->CNTH = unixTime >> 16;
+  RTC->CNTL = unixTime & 0xFFFF;
+  RTC->CRL &= ~RTC_CRL_CNF;
+  rtcWaitWrite();
+}
+#else
+static uint32_t s_offset = 0;
+
+void Rtc::begin() {}
+uint32_t Rtc::now() const { return s_offset + millis() / 1000UL; }
+void Rtc::set(uint32_t unixTime) { s_offset = unixTime - millis() / 1000UL; }
+#endif
+
+void Rtc::format(char* out, uint8_t len, uint32_t t) {
+  if (t < 1577836800UL) { snprintf(out, len, "+%lus", (unsigned long)t); return; }
+
+  // dny od 1970 -> občanské datum (H. Hinnant, days_to_civil)
+  const uint32_t sec = t % 86400UL;
+  int32_t z = (int32_t)(t / 86400UL) + 719468;
+  const int32_t era = z / 146097;
+  const uint32_t doe = (uint32_t)(z - era * 146097);
+  const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const uint32_t mp = (5 * doy + 2) / 153;
+  const uint32_t d = doy - (153 * mp + 2) / 5 + 1;
+  const uint32_t m = mp < 10 ? mp + 3 : mp - 9;
+  const uint32_t y = yoe + (uint32_t)era * 400 + (m <= 2);
+
+  snprintf(out, len, "%04lu-%02lu-%02lu %02lu:%02lu:%02lu",
+           (unsigned long)y, (unsigned long)m, (unsigned long)d,
+           (unsigned long)(sec / 3600), (unsigned long)(sec / 60 % 60), (unsigned long)(sec % 60));
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+
+// Sekundový čítač RTC F103 v backup doméně (LSE 32.768 kHz, bez LSE
+// náhradně LSI ~40 kHz). Běží i přes reset; nenastavený = sekundy od
+// prvního zapnutí, "time <unix>" na konzoli ho nastaví na UTC.
+// Host: millis()/1000 + nastavený posun.
+class Rtc {
+public:
+  void begin();
+  uint32_t now() const;
+  void set(uint32_t unixTime);
+  // čas vypadá jako nastavený (po roce 2020)
+  bool isSet() const { return now() >= 1577836800UL; }
+
+  // "YYYY-MM-DD hh:mm:ss" (UTC), nenastavený čas jako "+<s>s"
+  static void format(char* out, uint8_t len, uint32_t t);
+};
+
+extern Rtc rtc;
@@ -0,0 +1,180 @@
+#include "Sampler.h"
+#include "Dwt.h"
+
+static const uint32_t SAMPLE_PERIOD_US = 1000000UL / SAMPLE_HZ;
+
+static Sampler* s_sampler = nullptr;
+
+// volá AdcScan z DMA ISR po každé zdecimované dávce (= SAMPLE_HZ)
+static void onAdcBatch() { s_sampler->onTick(); }
+
+void Sampler::begin(AdcScan& adc) {
+  _adc = &adc;
+  _bank.begin(adc.slot(0));
+  resetRunStates();
+
+  s_sampler = this;
+  adc.onBatch(onAdcBatch);
+}
+
+void Sampler::setArmed(bool armed) {
+  if (armed == _armed) return;
+  // _ignoreUntilMs nastaví ISR (jeho časová osa)
+  if (armed) _armReq = true;
+  _armed = armed;
+}
+
+void Sampler::setRateDiv(uint8_t div) {
+  if (div == _rateDiv) return;
+  // přepnutí platí od příštího update TIM3 => čas jedné dávky může být o (div-1) ms mimo
+  _rateDiv = div;
+  _bank.setRateDiv(div);
+  _adc->setRateDiv(div);
+}
+
+void Sampler::emit(SampleEvt type, uint8_t gate, uint8_t stage, uint32_t arg, int16_t peak) {
+  SampleEvent e;
+  e.type = type;
+  e.gate = gate;
+  e.stage = stage;
+  e.tMs = _ms;
+  e.tUs = _us;
+  e.arg = arg;
+  e.peak = peak;
+  if (!_events.push(e)) _dropped++;
+}
+
+void Sampler::resetRunStates() {
+  // ARM OFF uprostřed přerušení => do záznamu jako ukončené
+  GateMask m = _bank.interrupted;
+  for (uint8_t i = 0; m; i++, m >>= 1) {
+    if (m & 1UL) emitBreakEnd(i);
+  }
+  _bank.resetRun();
+  _longestMs = 0;
+  _worstStage = 0;
+}
+
+void Sampler::onTick() {
+  // čas jen z počtu ticků => deterministický
+  const uint32_t dt = SAMPLE_PERIOD_US * _rateDiv;
+  _us += dt;
+  _subUs += dt;
+  while (_subUs >= 1000UL) { _subUs -= 1000UL; _ms++; }
+
+  _bank.update();
+  if (_tap) _tap(_bank);
+#if AWD_ONSET_ENABLE
+  updateWatchWindow();
+#endif
+
+  if (_armReq) {
+    _armReq = false;
+    _ignoreUntilMs = _ms + ARM_IGNORE_MS;
+  }
+
+  bool ignoring = _armed && (int32_t)(_ms - _ignoreUntilMs) < 0;
+  _ignoring = ignoring;
+
+  if (!_armed || ignoring) {
+    resetRunStates();
+    return;
+  }
+
+  evaluateRun();
+}
+
+void Sampler::updateWatchWindow() {
+  // jedno okno pro všechny kanály: hrana nejvýš položené baseline + DELTA_ON.
+  // Když je některá brána už mimo okno (přerušená), AWD by střílel pořád => vypnout.
+  const GateBank& b = _bank;
+#if DIFF_INVERT
+  uint16_t lim = 0, vmax = 0;
+  for (uint8_t i = 0; i < GATE_COUNT; i++) {
+    uint16_t top = (uint16_t)(b.base(i) + DELTA_ON);
+    if (top > lim) lim = top;
+    if (b.value(i) > vmax) vmax = b.value(i);
+  }
+  uint16_t hi12 = (uint16_t)((lim >> ADC_EXTRA_BITS) + AWD_MARGIN_12);
+  if (hi12 > 4095) hi12 = 4095;
+  _adc->setWatchWindow(0, hi12, (vmax >> ADC_EXTRA_BITS) < hi12);
+#else
+  int32_t lim = 0x7FFF, vmin = 0x7FFF;
+  for (uint8_t i = 0; i < GATE_COUNT; i++) {
+    int32_t bot = (int32_t)b.base(i) - (int32_t)DELTA_ON;
+    if (bot < lim) lim = bot;
+    if ((int32_t)b.value(i) < vmin) vmin = b.value(i);
+  }
+  int32_t lo12 = (lim >> ADC_EXTRA_BITS) - (int32_t)AWD_MARGIN_12;
+  if (lo12 < 0) lo12 = 0;
+  _adc->setWatchWindow((uint16_t)lo12, 4095, (vmin >> ADC_EXTRA_BITS) > lo12);
+#endif
+}
+
+uint32_t Sampler::onsetUs(uint8_t g) {
+  // začátek z AWD (přesně na us), jinak čas této dávky
+  uint32_t cyc;
+  if (!_adc->takeOnset(g, cyc)) return _us;
+  uint32_t ageUs = dwtCyclesToUs(_adc->batchCycles() - cyc);
+  if (ageUs > AWD_MAX_AGE_US) return _us;
+  return _us - ageUs;
+}
+
+static uint8_t stageFor(uint32_t ms) {
+  // SPEC: 0..1s ticho, 1..2s rychlé pípání, 2..3s táhlý tón, 3s+ alarm
+  if      (ms < STAGE1_MS) return 0;
+  else if (ms < STAGE2_MS) return 1;
+  else if (ms < STAGE3_MS) return 2;
+  return 3;
+}
+
+void Sampler::emitBreakEnd(uint8_t g) {
+  const GateBank& b = _bank;
+  uint32_t ms = (_us - b.sinceUs[g]) / 1000UL;
+  if ((b.counted & (1UL << g)) && ms < COUNT_AT_MS) ms = COUNT_AT_MS; // přetečení us
+  emit(SampleEvt::BreakEnd, g, stageFor(ms), ms, b.peak[g]);
+}
+
+void Sampler::evaluateRun() {
+  GateBank& b = _bank;
+  const GateMask broken = b.brokenMask();
+
+  // začátky / konce přerušení – jen brány, kde se něco změnilo
+  GateMask started = broken & ~b.interrupted;
+  GateMask ended   = b.interrupted & ~broken;
+
+  for (uint8_t i = 0; started; i++, started >>= 1) {
+    if (!(started & 1UL)) continue;
+    b.sinceUs[i] = onsetUs(i);
+    b.peak[i] = b.strength(i);
+    emit(SampleEvt::BreakStart, i, 0, _us - b.sinceUs[i]);
+  }
+  for (uint8_t i = 0; ended; i++, ended >>= 1) {
+    if (!(ended & 1UL)) continue;
+    emitBreakEnd(i);
+  }
+
+  b.interrupted = broken;
+  b.counted &= broken;
+
+  // nejhorší stupeň = stupeň nejdelšího přerušení (stage roste s časem)
+  uint32_t longestInterruptedMs = 0;
+  GateMask m = broken;
+  for (uint8_t i = 0; m; i++, m >>= 1) {
+    if (!(m & 1UL)) continue;
+    const GateMask bit = 1UL << i;
+    if (b.strength(i) > b.peak[i]) b.peak[i] = b.strength(i);
+    uint32_t ms = (_us - b.sinceUs[i]) / 1000UL;
+    // us čas přeteče po ~71 min – započítaná brána zůstává na plném stupni
+    if ((b.counted & bit) && ms < COUNT_AT_MS) ms = COUNT_AT_MS;
+    if (ms > longestInterruptedMs) longestInterruptedMs = ms;
+
+    if (!(b.counted & bit) && ms >= COUNT_AT_MS) {
+      b.counted |= bit;
+      emit(SampleEvt::Counted, i, stageFor(ms), ms);
+    }
+  }
+
+  _longestMs = longestInterruptedMs;
+  _worstStage = broken ? stageFor(longestInterruptedMs) : 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "GateBank.h"
+#include "AdcScan.h"
+#include "SpscRing.h"
+
+enum class SampleEvt : uint8_t {
+  BreakStart = 0,  // brána přerušena, arg = zpoždění detekce za začátkem (us)
+  BreakEnd,        // signál zpět (nebo ARM OFF), arg = délka (ms), stage = dosažený stupeň, peak
+  Counted,         // přerušení >= COUNT_AT_MS => +1 bod
+};
+
+struct SampleEvent {
+  SampleEvt type;
+  uint8_t gate;
+  uint8_t stage;
+  uint32_t tMs;
+  uint32_t tUs;    // čas vzorkovače (us) – latence zpracování v loop()
+  uint32_t arg;
+  int16_t peak;    // BreakEnd: max. síla (strength) během přerušení
+};
+
+// Vzorkování s pevnou frekvencí (SAMPLE_HZ) z ISR dávky ADC (TIM3 -> ADC -> DMA):
+// GateBank::update() + RUN přechody (přerušení, stupně, počítání).
+// Do loop() posílá události přes SPSC frontu – časování přerušení
+// tak nezávisí na tom, jak dlouho trvá UI nebo zvuk.
+class Sampler {
+public:
+  // odběr každého vzorku z ISR (telemetrie) – musí být krátký
+  typedef void (*TapFn)(const GateBank& bank);
+
+  // inicializuje brány z adc a zaregistruje se na jeho dávky
+  // (host: dávky spouští AdcScan::fakeBatch())
+  void begin(AdcScan& adc);
+
+  // ISR – jeden vzorek všech bran
+  void onTick();
+
+  // --- ovládání z loop() ---
+  void setArmed(bool armed);           // ARM ON => ignore okno ARM_IGNORE_MS
+  bool isArmed() const { return _armed; }
+  bool inIgnore() const { return _ignoring; }
+  // úsporný režim: vzorek jen každou div-tou periodu (AdcScan + GateBank), čas běží dál správně
+  void setRateDiv(uint8_t div);
+  uint8_t rateDiv() const { return _rateDiv; }
+
+  bool pollEvent(SampleEvent& e) { return _events.pop(e); }
+  bool hasEvents() const { return !_events.empty(); }
+  void setTap(TapFn fn) { _tap = fn; }
+
+  // --- stav pro loop()/UI ---
+  GateBank& bank() { return _bank; }
+  const GateBank& bank() const { return _bank; }
+  // stupeň alarmu jen jako stav (bez události ve frontě) – UI a zvuk ho čtou každý průchod
+  uint8_t worstStage() const { return _worstStage; }
+  uint32_t longestInterruptedMs() const { return _longestMs; }
+  uint32_t nowMs() const { return _ms; }
+  uint32_t nowUs() const { return _us; }
+  uint16_t droppedEvents() const { return _dropped; }
+
+private:
+  GateBank _bank;
+
+  SpscRing<SampleEvent, SAMPLE_EVT_QUEUE> _events;
+
+  AdcScan* _adc = nullptr;
+  volatile TapFn _tap = nullptr;
+
+  // čas vzorkovače (ms, us), odvozený jen z počtu ticků
+  volatile uint32_t _ms = 0;
+  volatile uint32_t _us = 0;
+  uint32_t _subUs = 0;
+  volatile uint8_t _rateDiv = 1;
+
+  volatile bool _armed = false;
+  volatile bool _ignoring = false;
+  volatile bool _armReq = false;
+  uint32_t _ignoreUntilMs = 0;
+
+  volatile uint8_t  _worstStage = 0;
+  volatile uint32_t _longestMs = 0;
+  volatile uint16_t _dropped = 0;
+
+  void resetRunStates();
+  void evaluateRun();
+  void updateWatchWindow();
+  uint32_t onsetUs(uint8_t g);
+  void emit(SampleEvt type, uint8_t gate, uint8_t stage, uint32_t arg, int16_t peak = 0);
+  void emitBreakEnd(uint8_t g);
+};
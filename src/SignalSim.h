@@ -0,0 +1,153 @@
+#pragma once
+#include <Arduino.h>
+#include <math.h>
+#include "config.h"
+#include "AdcScan.h"
+#include "MuxModel.h"
+
+// Simulovaný signál přijímačů pro fake AdcScan (host, bez BluePillu).
+// Model jednoho kanálu (12 bit, fotodioda s pull-upem => světlo snižuje napětí):
+//   v = dc - ambient(t) - (vysílač ON && paprsek ? beam : 0) + šum
+// ambient = slunce (konstanta) + zářivka (100 Hz) + pomalý drift (sinus,
+// omezený – simulace běží i hodiny). Kanál lze přepsat nahranou hodnotou.
+// Vysílač je ON v sudých skenech (LOCKIN_ENABLE), jinak pořád.
+// S muxem (MUX_ENABLE) jde úroveň brány na vstup ADC přes MuxModel (ustálení COM).
+// Pouze header – do firmware se dostane jen když ho někdo includuje.
+class SignalSim {
+public:
+  float dc        = 3000.0f; // tma
+  float sun       = 600.0f;  // okolní světlo
+  float flicker   = 250.0f;  // amplituda 100 Hz
+  float drift     = 80.0f;   // amplituda pomalého driftu okolí
+  float driftPeriodS = 900.0f;
+  float beam      = 500.0f;  // příspěvek paprsku
+  float noise     = 12.0f;   // špička šumu (rovnoměrný)
+
+  bool beamOn[GATE_COUNT];
+  int16_t raw[GATE_COUNT];   // >= 0: nahraný 12bit vzorek místo modelu
+
+  SignalSim() {
+    for (uint8_t i = 0; i < GATE_COUNT; i++) { beamOn[i] = true; raw[i] = -1; }
+    for (uint16_t i = 0; i < NOISE_LEN; i++) _noiseTab[i] = (int16_t)(nextSeed() >> 16);
+  }
+
+  void breakBeam(uint8_t g, bool broken) { if (g < GATE_COUNT) beamOn[g] = !broken; }
+  void setRaw(uint8_t g, int16_t v12) { if (g < GATE_COUNT) raw[g] = v12; }
+
+  // fast: jedna hodnota na kanál a dávku (bez zářivky a oversamplingu),
+  // šum odpovídá průměru ADC_OVERSAMPLE vzorků
+  bool fast = false;
+
+  // dávka, kterou ADC v úsporném režimu vynechá (AdcScan::rateDiv) – jen čas
+  void skipBatch() {
+    _scans += ADC_SCANS;
+    _t = (double)_scans / ((double)SAMPLE_HZ * (double)ADC_SCANS);
+  }
+
+  // naplní příští dávku adc (ADC_SCANS skenů) a zpracuje ji
+  void feedBatch(AdcScan& adc) {
+    const double scanDt = 1.0 / ((double)SAMPLE_HZ * (double)ADC_SCANS);
+    const float drf = drift * (float)sin(6.283185307 * _t / (double)driftPeriodS);
+    if (fast) { feedDecimated(adc, drf); return; }
+
+    // zářivka: fázor otáčený po skenech (sin jen jednou na dávku)
+    const double w = 6.283185307 * 100.0 * scanDt;
+    float fs = (float)sin(6.283185307 * 100.0 * _t), fc = (float)cos(6.283185307 * 100.0 * _t);
+    const float rs = (float)sin(w), rc = (float)cos(w);
+    uint16_t scan[ADC_INPUTS];
+
+    // šum z tabulky od náhodného místa (LCG jen jednou na dávku) – simulace hodin
+    const int32_t nq = (int32_t)noise;
+    uint16_t k = (uint16_t)(nextSeed() >> 16);
+    int32_t beamQ[GATE_COUNT];
+    for (uint8_t ch = 0; ch < GATE_COUNT; ch++) beamQ[ch] = beamOn[ch] ? (int32_t)beam : 0;
+
+    for (uint8_t s = 0; s < ADC_SCANS; s++) {
+#if LOCKIN_ENABLE
+      const bool emitter = (s & 1) == 0;
+#else
+      const bool emitter = true;
+#endif
+      const int32_t lvl = (int32_t)(dc - sun - drf - flicker * (0.5f + 0.5f * fs));
+#if MUX_ENABLE
+      float level[GATE_COUNT], com[ADC_INPUTS];
+      for (uint8_t g = 0; g < GATE_COUNT; g++) level[g] = (float)(raw[g] >= 0 ? raw[g] : lvl - beamQ[g]);
+      _mux.scan(level, com);
+      for (uint8_t in = 0; in < ADC_INPUTS; in++) {
+        int32_t v = (int32_t)lroundf(com[in]) + ((_noiseTab[k++ & (NOISE_LEN - 1)] * nq) >> 15);
+        scan[in] = (uint16_t)(v < 0 ? 0 : (v > 4095 ? 4095 : v));
+      }
+      (void)emitter;
+#else
+      for (uint8_t ch = 0; ch < GATE_COUNT; ch++) {
+        if (raw[ch] >= 0) { scan[ch] = (uint16_t)raw[ch]; continue; }
+        int32_t v = lvl - (emitter ? beamQ[ch] : 0) + ((_noiseTab[k++ & (NOISE_LEN - 1)] * nq) >> 15);
+        scan[ch] = (uint16_t)(v < 0 ? 0 : (v > 4095 ? 4095 : v));
+      }
+#endif
+      adc.injectScan(s, scan);
+
+      const float ns = fs * rc + fc * rs;
+      fc = fc * rc - fs * rs;
+      fs = ns;
+    }
+    _scans += ADC_SCANS;
+    _t = (double)_scans * scanDt;
+    adc.fakeBatch();
+  }
+
+  // okamžitá hodnota modelu bez šumu (HAL analogRead před první dávkou)
+  uint16_t level(uint8_t ch) const {
+    if (raw[ch] >= 0) return (uint16_t)raw[ch];
+    const float amb = sun + drift * (float)sin(6.283185307 * _t / (double)driftPeriodS)
+                    + flicker * (0.5f + 0.5f * (float)sin(6.283185307 * 100.0 * _t));
+    float v = dc - amb - (beamOn[ch] ? beam : 0.0f);
+    return (uint16_t)(v < 0.0f ? 0.0f : (v > 4095.0f ? 4095.0f : v));
+  }
+
+  double timeS() const { return _t; }
+
+#if MUX_ENABLE
+  const MuxModel& mux() const { return _mux; }
+#endif
+
+private:
+  void feedDecimated(AdcScan& adc, float drf) {
+    const int32_t nq = (int32_t)noise;
+    const int32_t scale = 1 << ADC_EXTRA_BITS;
+    uint16_t k = (uint16_t)(nextSeed() >> 16);
+#if LOCKIN_ENABLE
+    (void)drf;
+    const int32_t lvl = 0;  // demodulace odečte okolí
+    const int32_t sign = 1; // amplituda paprsku
+#else
+    const int32_t lvl = (int32_t)(dc - sun - drf);
+    const int32_t sign = -1;
+#endif
+    uint16_t dec[GATE_COUNT];
+    for (uint8_t ch = 0; ch < GATE_COUNT; ch++) {
+      int32_t v = (raw[ch] >= 0) ? raw[ch] : lvl + sign * (beamOn[ch] ? (int32_t)beam : 0);
+      v = v * scale + ((_noiseTab[k++ & (NOISE_LEN - 1)] * nq) >> 15);
+      dec[ch] = (uint16_t)(v < 0 ? (LOCKIN_ENABLE ? -v : 0) : (v > 4095 * scale ? 4095 * scale : v));
+    }
+    _scans += ADC_SCANS;
+    _t = (double)_scans / ((double)SAMPLE_HZ * (double)ADC_SCANS);
+    adc.fakeDecimated(dec);
+  }
+
+  double _t = 0.0;
+#if MUX_ENABLE
+  MuxModel _mux;
+#endif
+  uint64_t _scans = 0; // čas z počtu skenů – součet float by po hodinách ujížděl
+  uint32_t _seed = 12345;
+
+  // rovnoměrný šum -1..1 v Q15, deterministický
+  static const uint16_t NOISE_LEN = 4096;
+  int16_t _noiseTab[NOISE_LEN];
+
+  uint32_t nextSeed() {
+    _seed = _seed * 1664525UL + 1013904223UL; // LCG
+    return _seed;
+  }
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free fronta single-producer / single-consumer (ISR -> loop).
+// N musí být mocnina 2. Producent píše jen _head, konzument jen _tail,
+// takže na jednom jádře stačí compiler fence (žádné zakazování IRQ).
+template <typename T, uint16_t N>
+class SpscRing {
+  static_assert((N & (N - 1)) == 0, "N musi byt mocnina 2");
+
+public:
+  bool push(const T& v) {
+    uint16_t h = _head;
+    if ((uint16_t)(h - _tail) >= N) return false; // plno
+    _buf[h & (N - 1)] = v;
+    std::atomic_signal_fence(std::memory_order_release);
+    _head = (uint16_t)(h + 1);
+    return true;
+  }
+
+  bool pop(T& out) {
+    uint16_t t = _tail;
+    if (t == _head) return false; // prázdno
+    std::atomic_signal_fence(std::memory_order_acquire);
+    out = _buf[t & (N - 1)];
+    std::atomic_signal_fence(std::memory_order_release);
+    _tail = (uint16_t)(t + 1);
+    return true;
+  }
+
+  uint16_t size() const { return (uint16_t)(_head - _tail); }
+  bool empty() const { return _head == _tail; }
+
+private:
+  T _buf[N];
+  volatile uint16_t _head = 0;
+  volatile uint16_t _tail = 0;
+};
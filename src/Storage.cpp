@@ -2,39 +2,142 @@
 #include "config.h"
 #include <EEPROM.h>
 
+// původní layout (uint32 na bránu od adresy 0) – jen pro migraci
 static const int EEPROM_BASE_ADDR = 0;
 
+#if IR_HW_STM32
+static FlashStm32 s_flash(JOURNAL_FLASH_BASE, JOURNAL_PAGES);
+static FlashStm32 s_calFlash(CAL_FLASH_BASE, CAL_PAGES);
+static FlashStm32 s_logFlash(LOG_FLASH_BASE, LOG_PAGES);
+#endif
+
+static Storage* s_storage = nullptr;
+static void powerFailIsr() { s_storage->onPowerFail(); }
+
 void Storage::begin() {
-  EEPROM.begin();
+#if IR_HW_STM32
+  begin(s_flash, s_calFlash, s_logFlash);
+#else
+  static FlashRam<JOURNAL_PAGES> ram;
+  static FlashRam<CAL_PAGES> calRam;
+  static FlashRam<LOG_PAGES> logRam;
+  begin(ram, calRam, logRam);
+#endif
+}
+
+void Storage::begin(FlashIo& flash, FlashIo& calFlash, FlashIo& logFlash) {
+  _flash = &flash;
+  _cal.begin(calFlash);
+  _log.begin(logFlash);
+  _mirror.begin();
 }
 
 void Storage::loadCounts(uint32_t gateCounts[], uint8_t gateCount) {
-  for (uint8_t i = 0; i < gateCount && i < 10; i++) {
-    uint32_t v = 0xFFFFFFFFUL;
-    EEPROM.get(EEPROM_BASE_ADDR + (int)i * (int)sizeof(uint32_t), v);
-    if (v == 0xFFFFFFFFUL) v = 0;
-    gateCounts[i] = v;
-    _lastSaved[i] = v;
+  if (gateCount > MAX_GATES) gateCount = MAX_GATES;
+
+  if (!_journal.begin(*_flash, gateCounts, gateCount)) {
+    // první start se žurnálem: převzít počty ze staré EEPROM a založit stránku
+    EEPROM.begin();
+    for (uint8_t i = 0; i < gateCount; i++) {
+      uint32_t v = 0xFFFFFFFFUL;
+      EEPROM.get(EEPROM_BASE_ADDR + (int)i * (int)sizeof(uint32_t), v);
+      if (v == 0xFFFFFFFFUL) v = 0;
+      gateCounts[i] = v;
+    }
+    _journal.compact(gateCounts, gateCount);
+  }
+
+  for (uint8_t i = 0; i < gateCount; i++) _lastSaved[i] = gateCounts[i];
+
+  // body od posledního zápisu, které přežily reset v backup registrech
+  uint32_t deltas[MAX_GATES];
+  bool any = false;
+  if (_mirror.restore(deltas, gateCount)) {
+    for (uint8_t i = 0; i < gateCount; i++) {
+      gateCounts[i] += deltas[i];
+      if (deltas[i]) any = true;
+    }
+  }
+  if (any) commit(gateCounts, gateCount);
+  else _mirror.clear();
+}
+
+void Storage::noteCount(const uint32_t gateCounts[], uint8_t gate) {
+  if (gate >= MAX_GATES) return;
+  uint32_t d = gateCounts[gate] - _lastSaved[gate];
+  _mirror.setDelta(gate, d);
+  if (d >= BackupMirror::DELTA_MAX) _mirrorFull = true;
+}
+
+void Storage::commit(const uint32_t gateCounts[], uint8_t gateCount) {
+  for (uint8_t i = 0; i < gateCount; i++) {
+    if (gateCounts[i] != _lastSaved[i]) _journal.append(i, gateCounts[i], gateCounts, gateCount);
+    _lastSaved[i] = gateCounts[i];
   }
+  _mirror.clear();
 }
 
 void Storage::saveCountsIfNeeded(const uint32_t gateCounts[], uint8_t gateCount, bool force) {
   uint32_t now = millis();
+  if (gateCount > MAX_GATES) gateCount = MAX_GATES;
 
-  bool anyChange = force;
-  if (!force) {
-    for (uint8_t i = 0; i < gateCount && i < 10; i++) {
-      if (gateCounts[i] != _lastSaved[i]) { anyChange = true; break; }
-    }
+  bool anyChange = false;
+  for (uint8_t i = 0; i < gateCount; i++) {
+    if (gateCounts[i] != _lastSaved[i]) { anyChange = true; break; }
   }
-  if (!anyChange) return;
-  if (!force && (now - _lastSaveMs) < SAVE_EVERY_MS) return;
+  if (!anyChange && !force) return;
+  // zrcadlo v backup registrech saturuje => zapsat hned
+  if (!force && !_mirrorFull && (now - _lastSaveMs) < SAVE_EVERY_MS) return;
 
-  for (uint8_t i = 0; i < gateCount && i < 10; i++) {
-    if (force || gateCounts[i] != _lastSaved[i]) {
-      EEPROM.put(EEPROM_BASE_ADDR + (int)i * (int)sizeof(uint32_t), gateCounts[i]);
-      _lastSaved[i] = gateCounts[i];
-    }
+  _mirror.holdPvd();
+  if (force) {
+    // např. reset všech počtů => rovnou čistá stránka se snapshotem
+    _journal.compact(gateCounts, gateCount);
+    for (uint8_t i = 0; i < gateCount; i++) _lastSaved[i] = gateCounts[i];
+    _mirror.clear();
+  } else {
+    commit(gateCounts, gateCount);
   }
+  // rezerva pro PVD flush: tam už na mazání stránky (~20 ms) není čas
+  if (_journal.freeSlots() <= gateCount) _journal.compact(gateCounts, gateCount);
+  _mirror.releasePvd();
+
+  _mirrorFull = false;
   _lastSaveMs = now;
 }
+
+void Storage::enablePowerFailFlush(const uint32_t* gateCounts, uint8_t gateCount) {
+  s_storage = this;
+  _pfCounts = gateCounts;
+  _pfCount = gateCount > MAX_GATES ? MAX_GATES : gateCount;
+  _mirror.enablePvd(powerFailIsr);
+}
+
+void Storage::onPowerFail() {
+  // jen append do volných slotů (rezervu drží saveCountsIfNeeded)
+  if (_pfCounts) commit(_pfCounts, _pfCount);
+}
+
+bool Storage::loadCalibration(GateCal cal[], uint8_t gateCount) {
+  return _cal.load(cal, gateCount);
+}
+
+void Storage::saveCalibration(const GateCal cal[], uint8_t gateCount) {
+  // mazání stránky nesmí kolidovat s PVD flushem žurnálu
+  _mirror.holdPvd();
+  _cal.save(cal, gateCount);
+  _mirror.releasePvd();
+}
+
+void Storage::flushLogIfNeeded(uint32_t nowMs, bool quiet) {
+  if (!_log.flushDue(nowMs, quiet)) return;
+  _mirror.holdPvd();
+  _log.flush(nowMs);
+  _mirror.releasePvd();
+}
+
+void Storage::clearLog() {
+  _mirror.holdPvd();
+  _log.clear();
+  _mirror.releasePvd();
+}
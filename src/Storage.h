@@ -1,13 +1,61 @@
 #pragma once
 #include <Arduino.h>
+#include "FlashIo.h"
+#include "CounterJournal.h"
+#include "BackupMirror.h"
+#include "CalStore.h"
+#include "EventLog.h"
 
+// Počítadla bran ve flash žurnálu (CounterJournal) místo EEPROM.put()
+// na pevné adrese: jeden 8B záznam na změněnou bránu, mazání stránky
+// jen při kompakci (~jednou za 100+ uložení).
+// Každý nový bod se hned zrcadlí do backup registrů (noteCount) a při
+// výpadku napájení ho PVD přerušení dopíše do žurnálu => do flash stačí
+// psát jednou za SAVE_EVERY_MS.
+// Kalibrace bran (idle/zero/max/base) má vlastní stránky (CalStore),
+// aby start nemusel čekat na ustálení baseline.
+// Záznam jednotlivých přerušení (EventLog) leží na dalších stránkách.
 class Storage {
 public:
+  // HW flash (JOURNAL_FLASH_BASE, CAL_FLASH_BASE, LOG_FLASH_BASE)
   void begin();
+  // libovolná flash (host: FlashRam model)
+  void begin(FlashIo& flash, FlashIo& calFlash, FlashIo& logFlash);
+
+  // žurnál + neuložené přírůstky z backup registrů
   void loadCounts(uint32_t gateCounts[], uint8_t gateCount);
+  // po každém gateCounts[gate]++ (zrcadlo v backup doméně)
+  void noteCount(const uint32_t gateCounts[], uint8_t gate);
   void saveCountsIfNeeded(const uint32_t gateCounts[], uint8_t gateCount, bool force = false);
 
+  // PVD => poslední zápis counts do flash (z přerušení)
+  void enablePowerFailFlush(const uint32_t* gateCounts, uint8_t gateCount);
+  void onPowerFail();
+
+  // kalibrace: false = žádný platný záznam (nebo jiná verze / počet bran)
+  bool loadCalibration(GateCal cal[], uint8_t gateCount);
+  void saveCalibration(const GateCal cal[], uint8_t gateCount);
+
+  // záznam přerušení: do RAM hned, do flash po dávkách
+  void logBreak(const BreakRecord& r) { _log.add(r); }
+  void flushLogIfNeeded(uint32_t nowMs, bool quiet);
+  void clearLog();
+  const EventLog& log() const { return _log; }
+
 private:
+  static const uint8_t MAX_GATES = GATE_COUNT;
+
+  FlashIo* _flash = nullptr;
+  CounterJournal _journal;
+  CalStore _cal;
+  EventLog _log;
+  BackupMirror _mirror;
   uint32_t _lastSaveMs = 0;
-  uint32_t _lastSaved[10] = {0};
+  uint32_t _lastSaved[MAX_GATES] = {0};
+  bool _mirrorFull = false;
+
+  const uint32_t* _pfCounts = nullptr;
+  uint8_t _pfCount = 0;
+
+  void commit(const uint32_t gateCounts[], uint8_t gateCount);
 };
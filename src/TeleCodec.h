@@ -0,0 +1,269 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+// Binární telemetrie vzorků bran (raw + baseline po 1 vzorku vzorkovače).
+// Sdílí ji firmware (Telemetry) a host dekodér (tools/teledec.cpp) – proto
+// jen stdint, žádné Arduino.
+//
+// Rámec:  SYNC | typ | len | seq | payload[len] | crc16 LE
+//         crc16 = CCITT (0xFFFF) přes typ..payload; seq roste po rámcích.
+// KEY   : index u32, gates u8, flags u8, decim u8, raw u16 x gates, base u16 x gates
+// DELTA : index u16 (spodní bity prvního vzorku), n u8, pak n x
+//         { raw: zigzag varint rozdílu x gates, maska změn base (1 bit/brána),
+//           base: zigzag varint rozdílu jen pro brány v masce }
+// Rozdíly navazují na předchozí vzorek (i přes hranici rámce); ztracený
+// rámec => dekodér čeká na další KEY. diff dopočítá dekodér (FLAG_DIFF_INVERT).
+namespace tele {
+
+static const uint8_t SYNC       = 0xA5;
+static const uint8_t TYPE_KEY   = 'K';
+static const uint8_t TYPE_DELTA = 'D';
+
+static const uint8_t FLAG_DIFF_INVERT = 0x01;
+static const uint8_t FLAG_LOCKIN      = 0x02;
+
+// formát unese 32 bran (KEY 135 B); firmware si Sample zmenší na svůj
+// GATE_COUNT přes TELE_MAX_GATES (config.h) kvůli RAM
+#ifndef TELE_MAX_GATES
+  #define TELE_MAX_GATES 32
+#endif
+static const uint8_t MAX_GATES   = TELE_MAX_GATES;
+static const uint8_t HDR_LEN     = 4;   // SYNC, typ, len, seq
+static const uint8_t CRC_LEN     = 2;
+static const uint8_t MAX_PAYLOAD = 255;
+static const uint16_t MAX_FRAME  = HDR_LEN + MAX_PAYLOAD + CRC_LEN;
+// nejhorší vzorek DELTA: 3 B na hodnotu (14 bit zigzag) + maska
+static const uint16_t MAX_SAMPLE = MAX_GATES * 6 + (MAX_GATES + 7) / 8;
+// buffer kodéru: vzorek, který se už nevejde, se zapíše a pak odvolá
+static const uint16_t FRAME_BUF  = MAX_FRAME + MAX_SAMPLE;
+static_assert(MAX_GATES <= 32 && 3 + MAX_SAMPLE <= MAX_PAYLOAD, "TeleCodec: max. 32 bran");
+
+struct Sample {
+  uint16_t raw[MAX_GATES];
+  uint16_t base[MAX_GATES];
+};
+
+inline uint16_t crc16(uint16_t crc, uint8_t b) {
+  crc ^= (uint16_t)b << 8;
+  for (uint8_t k = 0; k < 8; k++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+  return crc;
+}
+
+inline uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+inline int32_t unzigzag(uint32_t u) { return (int32_t)(u >> 1) ^ -(int32_t)(u & 1); }
+
+// ------------------------------------------------------------
+// Kodér (firmware)
+// ------------------------------------------------------------
+class Encoder {
+public:
+  void begin(uint8_t gates, uint8_t flags, uint8_t decim) {
+    _gates = gates > MAX_GATES ? MAX_GATES : gates;
+    _flags = flags;
+    _decim = decim;
+    _seq = 0;
+  }
+
+  // celý KEY rámec do buf (cap >= FRAME_BUF), vrací délku
+  uint16_t keyframe(uint8_t* buf, uint32_t index, const Sample& s) {
+    uint8_t* p = buf + HDR_LEN;
+    put32(p, index);
+    *p++ = _gates;
+    *p++ = _flags;
+    *p++ = _decim;
+    for (uint8_t g = 0; g < _gates; g++) put16(p, s.raw[g]);
+    for (uint8_t g = 0; g < _gates; g++) put16(p, s.base[g]);
+    _prev = s;
+    return finish(buf, TYPE_KEY, p);
+  }
+
+  // DELTA rámec z až n vzorků (kolik se vejde do payloadu => *used), vrací délku
+  uint16_t deltas(uint8_t* buf, uint32_t firstIndex, const Sample* s, uint8_t n, uint8_t* used) {
+    uint8_t* p = buf + HDR_LEN;
+    put16(p, (uint16_t)firstIndex);
+    uint8_t* count = p++;
+    const uint8_t maskBytes = (uint8_t)((_gates + 7) / 8);
+
+    // vzorky se zapisují rovnou; ten, co přetekl payload, se vrátí
+    // (buf má rezervu MAX_SAMPLE) => rámce plné i pro 32 bran
+    uint8_t k = 0;
+    while (k < n) {
+      const Sample& c = s[k];
+      uint8_t* start = p;
+      for (uint8_t g = 0; g < _gates; g++) putVar(p, zigzag((int32_t)c.raw[g] - (int32_t)_prev.raw[g]));
+      uint8_t* mask = p;
+      memset(mask, 0, maskBytes);
+      p += maskBytes;
+      for (uint8_t g = 0; g < _gates; g++) {
+        if (c.base[g] == _prev.base[g]) continue;
+        mask[g >> 3] |= (uint8_t)(1 << (g & 7));
+        putVar(p, zigzag((int32_t)c.base[g] - (int32_t)_prev.base[g]));
+      }
+      if (p - (buf + HDR_LEN) > MAX_PAYLOAD) { p = start; break; }
+      _prev = c;
+      k++;
+    }
+    *count = k;
+    *used = k;
+    return finish(buf, TYPE_DELTA, p);
+  }
+
+private:
+  uint8_t _gates = 0, _flags = 0, _decim = 1, _seq = 0;
+  Sample _prev;
+
+  static void put16(uint8_t*& p, uint16_t v) { *p++ = (uint8_t)v; *p++ = (uint8_t)(v >> 8); }
+  static void put32(uint8_t*& p, uint32_t v) { put16(p, (uint16_t)v); put16(p, (uint16_t)(v >> 16)); }
+  static void putVar(uint8_t*& p, uint32_t v) {
+    while (v >= 0x80) { *p++ = (uint8_t)(v | 0x80); v >>= 7; }
+    *p++ = (uint8_t)v;
+  }
+
+  uint16_t finish(uint8_t* buf, uint8_t type, uint8_t* end) {
+    const uint16_t len = (uint16_t)(end - (buf + HDR_LEN));
+    buf[0] = SYNC;
+    buf[1] = type;
+    buf[2] = (uint8_t)len;
+    buf[3] = _seq++;
+    uint16_t crc = 0xFFFF;
+    for (uint8_t* q = buf + 1; q < end; q++) crc = crc16(crc, *q);
+    *end++ = (uint8_t)crc;
+    *end++ = (uint8_t)(crc >> 8);
+    return (uint16_t)(end - buf);
+  }
+};
+
+// ------------------------------------------------------------
+// Dekodér (host): po bajtech, vzorky přes callback
+// ------------------------------------------------------------
+class Decoder {
+public:
+  typedef void (*SampleFn)(void* ctx, uint32_t index, const Sample& s);
+
+  struct Stats {
+    uint32_t frames = 0;
+    uint32_t samples = 0;
+    uint32_t crcErrors = 0;
+    uint32_t gaps = 0;      // ztracené rámce / přerušený řetěz rozdílů
+    uint32_t skipped = 0;   // bajty mimo rámce
+  };
+
+  Decoder(SampleFn fn, void* ctx) : _fn(fn), _ctx(ctx) {}
+
+  void push(uint8_t b) {
+    if (_len == 0 && b != SYNC) { _st.skipped++; return; }
+    _buf[_len++] = b;
+    if (_len == 3 && _buf[1] != TYPE_KEY && _buf[1] != TYPE_DELTA) { resync(); return; }
+    if (_len < HDR_LEN || _len < (uint16_t)(HDR_LEN + _buf[2] + CRC_LEN)) return;
+
+    uint16_t crc = 0xFFFF;
+    const uint16_t end = (uint16_t)(HDR_LEN + _buf[2]);
+    for (uint16_t i = 1; i < end; i++) crc = crc16(crc, _buf[i]);
+    if (crc != (uint16_t)(_buf[end] | (_buf[end + 1] << 8))) { _st.crcErrors++; resync(); return; }
+
+    if (_haveSeq && _buf[3] != (uint8_t)(_seq + 1)) { _st.gaps++; _synced = false; }
+    _haveSeq = true;
+    _seq = _buf[3];
+    _st.frames++;
+    if (_buf[1] == TYPE_KEY) parseKey(); else parseDelta();
+    _len = 0;
+  }
+
+  const Stats& stats() const { return _st; }
+  uint8_t gates() const { return _gates; }
+  uint8_t flags() const { return _flags; }
+  uint8_t decim() const { return _decim; }
+
+private:
+  SampleFn _fn;
+  void* _ctx;
+  uint8_t _buf[MAX_FRAME];
+  uint16_t _len = 0;
+  Stats _st;
+
+  bool _haveSeq = false;
+  uint8_t _seq = 0;
+  bool _synced = false;     // máme KEY a nepřerušený řetěz rozdílů
+  uint8_t _gates = 0, _flags = 0, _decim = 1;
+  uint32_t _next = 0;       // index příštího vzorku
+  Sample _prev;
+
+  // chybný rámec: zkusit další SYNC uvnitř už přijatých bajtů
+  void resync() {
+    uint8_t tmp[MAX_FRAME];
+    const uint16_t n = _len;
+    memcpy(tmp, _buf, n);
+    _len = 0;
+    _st.skipped++;
+    for (uint16_t i = 1; i < n; i++) push(tmp[i]);
+  }
+
+  uint8_t* _p = nullptr;
+  uint8_t* _end = nullptr;
+  bool _ok = true;
+
+  uint8_t get8() { if (_p >= _end) { _ok = false; return 0; } return *_p++; }
+  uint16_t get16() { uint16_t v = get8(); return (uint16_t)(v | (get8() << 8)); }
+  uint32_t get32() { uint32_t v = get16(); return v | ((uint32_t)get16() << 16); }
+  uint32_t getVar() {
+    uint32_t v = 0;
+    for (uint8_t sh = 0; sh < 35; sh += 7) {
+      uint8_t b = get8();
+      v |= (uint32_t)(b & 0x7F) << sh;
+      if (!(b & 0x80)) break;
+    }
+    return v;
+  }
+
+  void parseKey() {
+    _p = _buf + HDR_LEN;
+    _end = _p + _buf[2];
+    _ok = true;
+    const uint32_t index = get32();
+    const uint8_t gates = get8();
+    _flags = get8();
+    _decim = get8();
+    if (gates > MAX_GATES || _decim == 0) { _synced = false; return; }
+    _gates = gates;
+    Sample s;
+    memset(&s, 0, sizeof(s));
+    for (uint8_t g = 0; g < _gates; g++) s.raw[g] = get16();
+    for (uint8_t g = 0; g < _gates; g++) s.base[g] = get16();
+    if (!_ok) { _synced = false; return; }
+    _prev = s;
+    _synced = true;
+    _next = index + _decim;
+    _st.samples++;
+    _fn(_ctx, index, s);
+  }
+
+  void parseDelta() {
+    if (!_synced) return;
+    _p = _buf + HDR_LEN;
+    _end = _p + _buf[2];
+    _ok = true;
+    const uint16_t first = get16();
+    const uint8_t n = get8();
+    if (first != (uint16_t)_next) { _st.gaps++; _synced = false; return; }
+
+    const uint8_t maskBytes = (uint8_t)((_gates + 7) / 8);
+    for (uint8_t k = 0; k < n && _ok; k++) {
+      Sample c = _prev;
+      for (uint8_t g = 0; g < _gates; g++) c.raw[g] = (uint16_t)((int32_t)_prev.raw[g] + unzigzag(getVar()));
+      uint8_t mask[(MAX_GATES + 7) / 8];
+      for (uint8_t i = 0; i < maskBytes; i++) mask[i] = get8();
+      for (uint8_t g = 0; g < _gates; g++) {
+        if (mask[g >> 3] & (1 << (g & 7))) c.base[g] = (uint16_t)((int32_t)_prev.base[g] + unzigzag(getVar()));
+      }
+      if (!_ok) break;
+      _prev = c;
+      _st.samples++;
+      _fn(_ctx, _next, c);
+      _next += _decim;
+    }
+    if (!_ok) { _st.gaps++; _synced = false; }
+  }
+};
+
+} // namespace tele
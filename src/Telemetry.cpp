@@ -0,0 +1,136 @@
+#include "Telemetry.h"
+
+void Telemetry::begin(Print& out) {
+  _out = &out;
+  uint8_t flags = 0;
+#if DIFF_INVERT
+  flags |= tele::FLAG_DIFF_INVERT;
+#endif
+#if LOCKIN_ENABLE
+  flags |= tele::FLAG_LOCKIN;
+#endif
+  _enc.begin(GATE_COUNT, flags, TELE_DECIM);
+}
+
+void Telemetry::setEnabled(bool on) {
+  if (on && !_on) {
+    Item it;
+    while (_queue.pop(it)) {}
+    _needKey = true;
+    _frames = _samples = _dropped = 0;
+  }
+  _on = on;
+}
+
+void Telemetry::onSample(const GateBank& bank) {
+  const uint32_t index = _tick++;
+  if (!_on || (index % TELE_DECIM) != 0) return;
+
+  Item it;
+  it.index = index;
+  for (uint8_t g = 0; g < GATE_COUNT; g++) {
+    it.raw[g] = bank.value(g);
+    it.base[g] = bank.base(g);
+  }
+  _queue.push(it); // plno => díra v indexech, service() pošle KEY
+}
+
+void Telemetry::toSample(const Item& it, tele::Sample& s) {
+  for (uint8_t g = 0; g < GATE_COUNT; g++) {
+    s.raw[g] = it.raw[g];
+    s.base[g] = it.base[g];
+  }
+}
+
+bool Telemetry::enqueue(uint16_t len) {
+  if ((uint16_t)(_outLen + len) > TELE_OUT_BUF) return false;
+  if ((uint16_t)(_outPos + _outLen + len) > TELE_OUT_BUF) {
+    memmove(_outBuf, _outBuf + _outPos, _outLen);
+    _outPos = 0;
+  }
+  memcpy(_outBuf + _outPos + _outLen, _frame, len);
+  _outLen = (uint16_t)(_outLen + len);
+  _frames++;
+  return true;
+}
+
+void Telemetry::sendKey(const Item& it) {
+  tele::Sample s;
+  toSample(it, s);
+  const uint16_t len = _enc.keyframe(_frame, it.index, s);
+  _next = it.index + TELE_DECIM;
+  _sinceKey = 0;
+  _needKey = !enqueue(len);
+  if (_needKey) _dropped++;
+  else _samples++;
+}
+
+void Telemetry::sendDeltas(uint32_t firstIndex, const tele::Sample* s, uint8_t n) {
+  while (n && !_needKey) {
+    uint8_t used = 0;
+    const uint16_t len = _enc.deltas(_frame, firstIndex, s, n, &used);
+    if (!enqueue(len)) {
+      // řetěz rozdílů přerušen => zbytek dávky pryč, další rámec KEY
+      _needKey = true;
+      _dropped += n;
+      return;
+    }
+    _samples += used;
+    _sinceKey = (uint16_t)(_sinceKey + used);
+    firstIndex += (uint32_t)used * TELE_DECIM;
+    s += used;
+    n = (uint8_t)(n - used);
+  }
+}
+
+void Telemetry::flush() {
+  if (!_outLen) return;
+  int room = _out->availableForWrite();
+  if (room <= 0) return;
+  const uint16_t n = (uint16_t)room < _outLen ? (uint16_t)room : _outLen;
+  _out->write(_outBuf + _outPos, n);
+  _outPos = (uint16_t)(_outPos + n);
+  _outLen = (uint16_t)(_outLen - n);
+  if (!_outLen) _outPos = 0;
+}
+
+void Telemetry::service() {
+  if (!_out) return;
+  flush();
+
+  if (!_on) {
+    Item it;
+    while (_queue.pop(it)) {}
+    return;
+  }
+
+  Item it;
+  for (;;) {
+    if (_needKey || _sinceKey >= TELE_KEY_EVERY) {
+      if (!_queue.pop(it)) break;
+      if (!_needKey && it.index != _next) _dropped += (it.index - _next) / TELE_DECIM;
+      sendKey(it);
+      continue;
+    }
+
+    // DELTA jen po celých dávkách (režie rámce 7 B)
+    if (_queue.size() < TELE_FRAME_SAMPLES) break;
+
+    tele::Sample batch[TELE_FRAME_SAMPLES];
+    const uint32_t first = _next;
+    uint8_t n = 0;
+    bool gap = false;
+    while (n < TELE_FRAME_SAMPLES && _queue.pop(it)) {
+      if (it.index != _next) { gap = true; break; }
+      toSample(it, batch[n++]);
+      _next += TELE_DECIM;
+    }
+    sendDeltas(first, batch, n);
+    if (gap) {
+      _dropped += (it.index - _next) / TELE_DECIM;
+      sendKey(it);
+    }
+  }
+
+  flush();
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <Arduino.h>
+#include "config.h"
+#include "GateBank.h"
+#include "SpscRing.h"
+#include "TeleCodec.h"
+
+// Binární stream vzorků bran (raw + baseline, diff dopočítá dekodér) pro
+// ladění prahů na PC – formát v TeleCodec.h, CSV dělá tools/teledec.cpp.
+// onSample() volá vzorkovač z ISR (jen kopie do fronty), service() z loop()
+// skládá rámce a posílá jen tolik, kolik pojme TX buffer – nikdy neblokuje.
+// Když linka nestíhá (nebo se zaplní fronta), vzorky se zahodí a další
+// rámec je KEY. Text konzole se může vklínit mezi rámce; dekodér ho přeskočí.
+class Telemetry {
+public:
+  void begin(Print& out);
+  void setEnabled(bool on);
+  bool enabled() const { return _on; }
+
+  // ISR – po GateBank::update()
+  void onSample(const GateBank& bank);
+
+  // loop()
+  void service();
+
+  uint32_t frames() const { return _frames; }
+  uint32_t samples() const { return _samples; }
+  uint32_t dropped() const { return _dropped; }
+
+private:
+  struct Item {
+    uint32_t index;  // pořadí vzorku vzorkovače
+    uint16_t raw[GATE_COUNT];
+    uint16_t base[GATE_COUNT];
+  };
+
+  SpscRing<Item, TELE_QUEUE> _queue;
+  tele::Encoder _enc;
+  Print* _out = nullptr;
+
+  volatile bool _on = false;
+  uint32_t _tick = 0;       // ISR
+
+  bool _needKey = true;
+  uint16_t _sinceKey = 0;
+  uint32_t _next = 0;       // očekávaný index dalšího vzorku
+
+  uint32_t _frames = 0;
+  uint32_t _samples = 0;
+  uint32_t _dropped = 0;
+
+  uint8_t _frame[tele::FRAME_BUF];
+  uint8_t _outBuf[TELE_OUT_BUF];
+  uint16_t _outPos = 0, _outLen = 0;
+
+  void sendKey(const Item& it);
+  void sendDeltas(uint32_t firstIndex, const tele::Sample* s, uint8_t n);
+  bool enqueue(uint16_t len);
+  void flush();
+  static void toSample(const Item& it, tele::Sample& s);
+};
@@ -1,5 +1,6 @@
 #include "UiOled.h"
 #include "config.h"
+#include "Profiler.h"
 #include <Wire.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
@@ -8,31 +9,263 @@
 #define SCREEN_HEIGHT 64
 #define OLED_RESET -1
 
-static Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+// Adafruit knihovna přepíná hodiny při každém přenosu => obě na OLED_I2C_HZ
+static Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET,
+                                OLED_I2C_HZ, OLED_I2C_HZ);
+
+static UiOled* s_ui = nullptr;
 
 bool UiOled::begin() {
+  s_ui = this;
   Wire.begin();
+  Wire.setClock(OLED_I2C_HZ);
   _ok = display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDR);
   if (_ok) { display.clearDisplay(); display.display(); }
+
+  for (uint8_t p = 0; p < PAGES; p++) {
+    // horizontální adresování (nastavuje display.begin()): okno = 1 stránka
+    const uint8_t hdr[PKT_HDR] = {
+      0x80, 0x22, 0x80, p, 0x80, p,                      // PAGEADDR p..p
+      0x80, 0x21, 0x80, 0x00, 0x80, SCREEN_WIDTH - 1,    // COLUMNADDR 0..127
+      0x40                                               // dál data
+    };
+    memcpy(_pkt[p], hdr, PKT_HDR);
+    memset(_pkt[p] + PKT_HDR, 0, 128);
+  }
+  _txMask = 0;
+  _inFlight = false;
+  _valid = false;
+
+#if IR_HW_STM32
+  RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+  DMA1_Channel6->CCR = 0;
+  DMA1_Channel6->CPAR = (uint32_t)&I2C1->DR;
+  // nejnižší priorita (F1 = 4 bity, 15): ISR čeká aktivně na I2C (START/ADDR/BTF,
+  // desítky us) => ADC1_2 (0), DMA1 Ch1 vzorkovače (1), EXTI tlačítek (6)
+  // i časovač pieza (14) ho přeruší, nic z nich neblokuje
+  NVIC_SetPriority(DMA1_Channel6_IRQn, 15);
+  NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+#endif
   return _ok;
 }
 
+void UiOled::showFault(const char* msg) {
+  if (!_ok) return;
+  display.clearDisplay();
+  display.setTextSize(1);
+  display.setTextColor(SSD1306_WHITE);
+  display.setCursor(0, 0);
+  display.print("CHYBA");
+  display.setCursor(0, 16);
+  display.print(msg);
+  display.display();
+  _valid = false;
+}
+
+bool UiOled::changed(const UiState& s, const uint32_t gateCounts[], uint8_t gateCount) const {
+  if (!_valid) return true;
+  const UiState& l = _last;
+  if (s.mode != l.mode) return true;
+
+  if (s.mode == AppMode::Diag) {
+    if (s.profPage != l.profPage) return true;
+    if (s.profPage) return s.profGen != l.profGen;
+    return s.selectedGate != l.selectedGate || s.diff != l.diff
+        || s.diffPeak != l.diffPeak || s.noise != l.noise
+        || s.level != l.level || s.levelThr != l.levelThr || s.calibrated != l.calibrated;
+  }
+
+  if (s.armed != l.armed || s.broken != l.broken
+      || s.inIgnore != l.inIgnore || s.stage != l.stage) return true;
+  for (uint8_t i = 0; i < gateCount && i < MAX_GATES; i++) {
+    if (gateCounts[i] != _lastCounts[i]) return true;
+  }
+  return false;
+}
+
 void UiOled::draw(const UiState& s, const uint32_t gateCounts[], uint8_t gateCount) {
   if (!_ok) return;
 
+  // předchozí snímek ještě letí => nekreslit (stav zůstane "změněný" na příště);
+  // NACK / ztráta arbitráže za ADDR => TC nepřijde, po OLED_TX_TIMEOUT_MS zahodit
+  if (_inFlight) {
+    if (millis() - _kickMs > OLED_TX_TIMEOUT_MS) {
+      noInterrupts();
+      if (_inFlight) failTx();
+      interrupts();
+    }
+    return;
+  }
+
+  if (_wantAwake != _awake) {
+    display.ssd1306_command(_wantAwake ? SSD1306_DISPLAYON : SSD1306_DISPLAYOFF);
+    _awake = _wantAwake;
+  }
+  if (!_awake) return;
+
+  // statická scéna => žádné kreslení ani přenos
+  if (!changed(s, gateCounts, gateCount)) return;
+
+  render(s, gateCounts, gateCount);
+  uint8_t dirty = collectDirtyPages();
+
+  _last = s;
+  for (uint8_t i = 0; i < gateCount && i < MAX_GATES; i++) _lastCounts[i] = gateCounts[i];
+  _valid = true;
+
+  if (dirty) {
+    _txMask = dirty;
+    _inFlight = true;
+    if (!kick()) abortTx();
+  }
+}
+
+uint8_t UiOled::collectDirtyPages() {
+  const uint8_t* fb = display.getBuffer();
+  uint8_t dirty = 0;
+  for (uint8_t p = 0; p < PAGES; p++) {
+    const uint8_t* src = fb + (uint16_t)p * 128;
+    uint8_t* dst = _pkt[p] + PKT_HDR;
+    if (_valid && memcmp(src, dst, 128) == 0) continue;
+    memcpy(dst, src, 128);
+    dirty |= (uint8_t)(1U << p);
+  }
+  return dirty;
+}
+
+void UiOled::abortTx() {
+  _txMask = 0;
+  _inFlight = false;
+  _valid = false; // displej je v neznámém stavu => příště celý
+}
+
+#if IR_HW_STM32
+
+extern "C" void DMA1_Channel6_IRQHandler(void) {
+  const uint32_t isr = DMA1->ISR;
+  DMA1->IFCR = DMA_IFCR_CGIF6;
+  if (isr & DMA_ISR_TEIF6) s_ui->failTx(); // TC už nepřijde
+  else if (isr & DMA_ISR_TCIF6) s_ui->onTxDone();
+}
+
+// STOP na sběrnici, I2C bez DMA, kanál vypnout
+static void stopBus() {
+  I2C1->CR1 |= I2C_CR1_STOP;
+  I2C1->CR2 &= ~I2C_CR2_DMAEN;
+  DMA1_Channel6->CCR = 0;
+}
+
+// krátké čekání na příznak I2C (SB/ADDR ~ 1 bajt = 23 us při 400 kHz)
+static bool waitSr1(uint32_t flag) {
+  uint32_t n = 4000;
+  while (!(I2C1->SR1 & flag)) {
+    if ((I2C1->SR1 & I2C_SR1_AF) || --n == 0) return false;
+  }
+  return true;
+}
+
+// START + adresa blokujícím způsobem (pár desítek us), data pak jedou přes DMA
+bool UiOled::kick() {
+  uint8_t p = 0;
+  while (!(_txMask & (1U << p))) p++;
+  _txPage = p;
+  _kickMs = millis();
+
+  uint32_t n = 4000;
+  while (I2C1->CR1 & I2C_CR1_STOP) { if (--n == 0) return false; }
+
+  DMA1_Channel6->CCR = 0;
+  DMA1_Channel6->CMAR = (uint32_t)_pkt[p];
+  DMA1_Channel6->CNDTR = PKT_LEN;
+  DMA1_Channel6->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_TCIE | DMA_CCR_TEIE;
+  DMA1_Channel6->CCR |= DMA_CCR_EN;
+
+  I2C1->SR1 = 0;
+  I2C1->CR2 |= I2C_CR2_DMAEN;
+  I2C1->CR1 |= I2C_CR1_START;
+  if (!waitSr1(I2C_SR1_SB)) goto fail;
+  I2C1->DR = (uint8_t)(OLED_ADDR << 1);
+  if (!waitSr1(I2C_SR1_ADDR)) goto fail;
+  (void)I2C1->SR2; // SR1+SR2 čtení maže ADDR => DMA začne plnit DR
+  return true;
+
+fail:
+  stopBus();
+  return false;
+}
+
+void UiOled::onTxDone() {
+  // DMA doplnilo poslední bajt do DR => počkat, než odejde (BTF), pak STOP
+  bool ok = waitSr1(I2C_SR1_BTF);
+  stopBus();
+  if (!ok) { abortTx(); return; }
+
+  _txMask &= (uint8_t)~(1U << _txPage);
+  if (_txMask == 0) { _inFlight = false; return; }
+  if (!kick()) abortTx();
+}
+
+void UiOled::failTx() {
+  stopBus();
+  abortTx();
+}
+
+#else
+
+// host build: "přenos" přes Wire stub synchronně
+bool UiOled::kick() {
+  while (_txMask) {
+    uint8_t p = 0;
+    while (!(_txMask & (1U << p))) p++;
+    _txPage = p;
+    Wire.beginTransmission(OLED_ADDR);
+    Wire.write(_pkt[p], PKT_LEN);
+    Wire.endTransmission();
+    onTxDone();
+  }
+  return true;
+}
+
+void UiOled::onTxDone() {
+  _txMask &= (uint8_t)~(1U << _txPage);
+  if (_txMask == 0) _inFlight = false;
+}
+
+void UiOled::failTx() { abortTx(); }
+
+#endif
+
+// 0.1 % => "12.3%"
+static void printLevel(int16_t v) {
+  if (v < 0) { display.print('-'); v = (int16_t)-v; }
+  display.print(v / 10);
+  display.print('.');
+  display.print(v % 10);
+  display.print('%');
+}
+
+void UiOled::render(const UiState& s, const uint32_t gateCounts[], uint8_t gateCount) {
   display.clearDisplay();
   display.setTextSize(1);
   display.setTextColor(SSD1306_WHITE);
 
+  if (s.mode == AppMode::Diag && s.profPage) {
+    renderProf();
+    return;
+  }
+
   if (s.mode == AppMode::Diag) {
     // --- DIAG obrazovka ---
     display.setCursor(0, 0);
     display.print("DIAG  B");
     display.print((int)s.selectedGate + 1);
+    if (s.calibrated) display.print("  ZERO/MAX");
 
     display.setCursor(0, 12);
     display.print("diff:");
     display.print(s.diff);
+    display.setCursor(66, 12);
+    printLevel(s.level);
 
     display.setCursor(0, 24);
     display.print("peak:");
@@ -44,10 +277,8 @@ void UiOled::draw(const UiState& s, const uint32_t gateCounts[], uint8_t gateCou
 
     display.setCursor(0, 52);
     display.print("thr:");
-    display.print((int)DELTA_ON);
-    display.print("  10x=EXIT");
-
-    display.display();
+    printLevel(s.levelThr);
+    display.print(" 10x=EXIT");
     return;
   }
 
@@ -57,25 +288,80 @@ void UiOled::draw(const UiState& s, const uint32_t gateCounts[], uint8_t gateCou
   display.print("ARM:");
   display.print(s.armed ? "ON " : "OFF");
   display.print(" G1:");
-  display.print(s.gate1Signal ? "OK" : "BR");
+  display.print((s.broken & 1UL) ? "BR" : "OK");
   if (s.inIgnore) display.print(" IGN");
   display.print(" S");
   display.print(s.stage);
 
-  // 10 bran (2 sloupce x 5 řádků)
+  if (gateCount > MAX_GATES) gateCount = MAX_GATES;
+  if (gateCount > 10) {
+    renderGrid(s, gateCounts, gateCount);
+    return;
+  }
+
+  // do 10 bran (2 sloupce x 5 řádků)
   const uint8_t y0 = 12, dy = 10;
-  for (uint8_t i = 0; i < gateCount && i < 10; i++) {
+  for (uint8_t i = 0; i < gateCount; i++) {
     uint8_t col = (i < 5) ? 0 : 1;
     uint8_t row = (i < 5) ? i : (i - 5);
     uint8_t x = (col == 0) ? 0 : 64;
     uint8_t y = y0 + row * dy;
 
     display.setCursor(x, y);
-    display.print("B");
+    display.print(((s.broken >> i) & 1UL) ? "*" : "B");
     display.print(i + 1);
     display.print(":");
     display.print(gateCounts[i]);
   }
+}
 
-  display.display();
+void UiOled::renderGrid(const UiState& s, const uint32_t gateCounts[], uint8_t gateCount) {
+  // 11..32 bran (mux): 8 řádků po 7 px (font 5x7) pod hlavičkou, sloupce po 8
+  // branách; přerušená brána inverzně. "12:34", počet přes šířku buňky => "12:+"
+  const uint8_t rows = 8, y0 = 8, dy = 7;
+  const uint8_t cols = (uint8_t)((gateCount + rows - 1) / rows);
+  const uint8_t w = (uint8_t)(128 / cols);
+  const uint8_t chars = (uint8_t)(w / 6);
+
+  for (uint8_t i = 0; i < gateCount; i++) {
+    const uint8_t x = (uint8_t)((i / rows) * w);
+    const uint8_t y = (uint8_t)(y0 + (i % rows) * dy);
+    const bool br = (s.broken >> i) & 1UL;
+    if (br) display.fillRect(x, y, w - 1, dy, SSD1306_WHITE);
+    display.setTextColor(br ? SSD1306_BLACK : SSD1306_WHITE);
+
+    char buf[12];
+    uint8_t n = (uint8_t)snprintf(buf, sizeof(buf), "%u:%lu", (unsigned)(i + 1), (unsigned long)gateCounts[i]);
+    if (n > chars) snprintf(buf, sizeof(buf), "%u:+", (unsigned)(i + 1));
+    display.setCursor(x, y);
+    display.print(buf);
+  }
+  display.setTextColor(SSD1306_WHITE);
+}
+
+void UiOled::renderProf() {
+  // --- DIAG: PROF (us, avg/max od posledního resetu) ---
+  display.setCursor(0, 0);
+  display.print("PROF us  avg/max");
+
+  static const Prof ROWS[] = { Prof::Loop, Prof::AdcIsr, Prof::Ui, Prof::Sound, Prof::Storage };
+  uint8_t y = 10;
+  for (Prof p : ROWS) {
+    const ProfStat& st = profiler.stat(p);
+    display.setCursor(0, y);
+    display.print(Profiler::name(p));
+    display.setCursor(30, y);
+    display.print(st.avgUs());
+    display.print("/");
+    display.print(st.maxUs());
+    y += 9;
+  }
+
+  const ProfStat& lat = profiler.latency();
+  display.setCursor(0, y);
+  display.print("lat");
+  display.setCursor(30, y);
+  display.print(lat.avgUs());
+  display.print("/");
+  display.print(lat.maxUs());
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <Arduino.h>
+#include "GateBank.h"
 
 enum class AppMode : uint8_t {
   Run = 0,
@@ -10,23 +11,85 @@ struct UiState {
   AppMode mode = AppMode::Run;
 
   bool armed = false;         // v RUN
-  bool gate1Signal = false;   // v RUN
+  GateMask broken = 0;        // v RUN, bit i = brána i bez signálu
   bool inIgnore = false;      // v RUN
   uint8_t stage = 0;          // 0..4 (RUN)
-  uint32_t interruptedMs = 0; // RUN debug
+  uint32_t interruptedMs = 0; // RUN debug (nevykresluje se)
 
   // společné / DIAG
-  uint8_t selectedGate = 0;   // 0..9 (B1..B10)
+  uint8_t selectedGate = 0;   // 0..GATE_COUNT-1 (B1..)
   int16_t diff = 0;
   int16_t diffPeak = 0;
   int16_t noise = 0;
+  int16_t level = 0;          // 0.1 % (GateBank::level)
+  int16_t levelThr = 0;
+  bool calibrated = false;    // platná dvojice ZERO/MAX
+
+  // DIAG stránka PROF (Profiler); profGen mění main => překreslení čísel
+  bool profPage = false;
+  uint32_t profGen = 0;
 };
 
+// SSD1306 128x64 přes I2C (fast-mode).
+// draw() překresluje jen při změně UiState/počtů a na sběrnici posílá
+// jen změněné 128bajtové stránky. Přenos běží na pozadí přes I2C1 + DMA1
+// Channel6 (stránka po stránce z DMA ISR); dokud je snímek na cestě,
+// draw() nic nekreslí a hned se vrací. Zhasnutý displej (setAwake) taky ne.
+// ISR kanálu 6 krátce čeká aktivně na I2C (START/ADDR/BTF), proto má
+// nejnižší prioritu NVIC: vzorkovač (ADC, DMA1 Ch1) i ostatní ISR ho přeruší.
 class UiOled {
 public:
   bool begin();
   void draw(const UiState& s, const uint32_t gateCounts[], uint8_t gateCount);
 
+  // HW chyba při startu: text hned (blokující I2C, ještě bez DMA)
+  void showFault(const char* msg);
+
+  // vynutí kompletní překreslení při příštím draw()
+  void invalidate() { _valid = false; }
+
+  // snímek se ještě posílá
+  bool busy() const { return _inFlight; }
+
+  // úsporný režim: displej zhasnout / rozsvítit (provede příští draw(),
+  // až nic neletí); zhasnutý se nepřekresluje, GDDRAM drží poslední snímek
+  void setAwake(bool on) { _wantAwake = on; }
+  bool awake() const { return _awake; }
+
+  // DMA ISR
+  void onTxDone();
+  // chyba přenosu (TEIF) / timeout: STOP, DMA vypnout, příště celý snímek
+  void failTx();
+
 private:
+  static const uint8_t PAGES = 8;
+  static const uint8_t MAX_GATES = BUS_GATES; // master sběrnice kreslí i brány slave
+  // I2C paket stránky: příkazy s Co=1 (PAGEADDR, COLUMNADDR) + 0x40 + 128 B dat
+  static const uint8_t PKT_HDR = 13;
+  static const uint8_t PKT_LEN = PKT_HDR + 128;
+
   bool _ok = false;
+  bool _awake = true;
+  bool _wantAwake = true;
+
+  // co je právě na displeji
+  bool _valid = false;
+  UiState _last;
+  uint32_t _lastCounts[MAX_GATES] = {0};
+
+  // hotové pakety = zároveň stínová kopie displeje (datová část);
+  // během přenosu je čte DMA, proto se do nich nekreslí
+  uint8_t _pkt[PAGES][PKT_LEN];
+  volatile uint8_t _txMask = 0;   // stránky čekající na odeslání
+  volatile uint8_t _txPage = 0;
+  volatile bool _inFlight = false;
+  volatile uint32_t _kickMs = 0;  // start přenosu stránky (timeout v draw())
+
+  bool changed(const UiState& s, const uint32_t gateCounts[], uint8_t gateCount) const;
+  void render(const UiState& s, const uint32_t gateCounts[], uint8_t gateCount);
+  void renderGrid(const UiState& s, const uint32_t gateCounts[], uint8_t gateCount);
+  void renderProf();
+  uint8_t collectDirtyPages();
+  bool kick();
+  void abortTx();
 };
@@ -4,7 +4,23 @@
 // -------- Piny --------
 // POZOR: musí to být #define, protože se používá v #if (preprocesor)
 #define USE_PIEZO_PORT_B 1   // 1=PB8/PB9, 0=PA8/PA9
-#define DIFF_INVERT 1        // 1: diff=v-base, 0: diff=base-v
+// DIFF_INVERT volí stranu přerušení: RUN bere jen výchylku, kdy diff roste
+// (bez lock-in). Nesedí-li se zapojením, RUN žádné přerušení nezachytí.
+#define DIFF_INVERT 1        // 1: diff=v-base (přerušení zvedá v), 0: diff=base-v
+#define LOCKIN_ENABLE 0      // 1: vysílače modulované z TIM3 CH3 (PB0), synchronní demodulace
+#define DUAL_ADC_ENABLE 1    // 1: ADC1+ADC2 současně (regular simultaneous) => poloviční doba skenu
+
+#define PROFILER_ENABLE 1    // 1: DWT měření úseků loop()/ISR (DIAG stránka PROF, příkaz "prof")
+#define AUTO_THR_ENABLE 1    // 1: RUN práh každé brány z jejího šumu (k·sigma), 0: pevný RUN_THR
+#define TELEMETRY_ENABLE 1   // 1: binární stream vzorků bran po Serial (příkaz "tele on")
+#define POWER_SAVE_ENABLE 1  // 1: WFI mezi dávkami, pomalejší vzorkování bez ARM, OLED po nečinnosti off
+
+// Cílový HW (BluePill, registry STM32F1) vs. host build (fake ADC apod.)
+#if defined(STM32F1xx)
+  #define IR_HW_STM32 1
+#else
+  #define IR_HW_STM32 0
+#endif
 
 // I2C OLED (BluePill I2C1)
 static const uint8_t I2C_SCL = PB6;
@@ -16,28 +32,220 @@ static const uint8_t BTN2_PIN = PB11;
 
 // Dlouhý stisk BTN2: reset počítadel (ms)
 static const uint16_t BTN2_HOLD_RESET_MS = 10000;
+// DIAG: držení BTN1 ukládá každých CAL_HOLD_STAGE_MS střídavě ZERO / MAX
+static const uint16_t CAL_HOLD_STAGE_MS = 5000;
+// úroveň tlačítka platí, když vydrží tak dlouho (EXTI, Buttons.h)
+static const uint8_t  BTN_DEBOUNCE_MS = 25;
 
-// Piezo piny
+// Piezo piny + kanály PWM časovače (push-pull: A=PWM1, B=PWM2 se stejným CCR)
 #if USE_PIEZO_PORT_B
-  static const uint8_t PZ_A = PB8;
-  static const uint8_t PZ_B = PB9;
+  static const uint8_t PZ_A = PB8;   // TIM4_CH3
+  static const uint8_t PZ_B = PB9;   // TIM4_CH4
+  static const uint8_t PZ_CH_A = 3;
+  static const uint8_t PZ_CH_B = 4;
+#else
+  static const uint8_t PZ_A = PA8;   // TIM1_CH1
+  static const uint8_t PZ_B = PA9;   // TIM1_CH2
+  static const uint8_t PZ_CH_A = 1;
+  static const uint8_t PZ_CH_B = 2;
+#endif
+
+// -------- IR brány --------
+// Počet bran GATE_COUNT je jediná konstanta, ze které se odvozuje všechno
+// ostatní (ADC sken, DMA buffery, GateBank, úložiště, UI, telemetrie).
+// MUX_ENABLE=0: každá brána na vlastním vstupu ADC (PA0..PA7).
+// MUX_ENABLE=1: brány přes analogové multiplexery CD4067 (16 cest) nebo
+// CD4051 (8 cest), COM každého muxu na jednom vstupu ADC. Adresní vodiče
+// nastavuje DMA z TIM3 (MuxScan.h) => přepnutí a ustálení jedné skupiny
+// muxů běží během převodu druhé skupiny, loop() ani ISR do toho nesahá.
+#ifndef MUX_ENABLE
+  #define MUX_ENABLE 0
+#endif
+
+#if MUX_ENABLE
+  static const uint8_t  MUX_WAYS  = 16;   // CD4067 (CD4051 = 8)
+  static const uint8_t  MUX_COUNT = 2;    // multiplexerů = vstupů ADC
+  static const uint8_t  GATE_COUNT = MUX_COUNT * MUX_WAYS; // brána = mux*MUX_WAYS + adresa
+  static const uint8_t  ADC_INPUTS = MUX_COUNT;
+  static const uint8_t  ADC_PINS[ADC_INPUTS] = { PA0, PA1 };   // COM muxů
+  static const uint8_t  ADC_CH[ADC_INPUTS]   = { 0, 1 };       // ADC1_IN0, IN1
+  // dvě skupiny adresních vodičů (S0..S3, vše na GPIOB): skupina 0 = prvních
+  // MUX_GROUP0 muxů v pořadí skenu, skupina 1 = zbytek. PB3/PB4 jsou po resetu
+  // JTAG => MuxScan přepne SWJ na SWD-only. S DUAL_ADC_ENABLE se oba COM
+  // vzorkují současně => obě skupiny se přepínají naráz až po nich.
+  static const uint8_t  MUX_GROUP0 = (MUX_COUNT + 1) / 2;
+  static const uint8_t  MUX_SEL_PINS[2][4] = { { PB12, PB13, PB14, PB15 }, { PB1, PB3, PB4, PB5 } };
+  static const uint16_t MUX_GUARD_NS = 250; // rezerva za koncem vzorkování skupiny 0 před přepnutím
+#else
+  static const uint8_t  MUX_WAYS  = 1;
+  static const uint8_t  GATE_COUNT = 8;
+  static const uint8_t  ADC_INPUTS = GATE_COUNT;
+  static const uint8_t  ADC_PINS[ADC_INPUTS] = { PA0, PA1, PA2, PA3, PA4, PA5, PA6, PA7 };
+  static const uint8_t  ADC_CH[ADC_INPUTS]   = { 0, 1, 2, 3, 4, 5, 6, 7 }; // ADC1_IN0..IN7
+#endif
+static_assert(GATE_COUNT <= 32, "GateMask ma 32 bitu");
+static_assert(ADC_INPUTS <= 16, "ADC1 regular sekvence ma max. 16 prevodu");
+
+// -------- Vzorkování (timer -> ADC -> DMA, nezávislé na loop()) --------
+// TIM3 TRGO spouští sken všech vstupů ADC SAMPLE_HZ*ADC_SCANS krát za s
+// (s muxem jedna adresa na sken => ADC_SCANS = MUX_WAYS*ADC_OVERSAMPLE).
+// DMA plní 2 poloviny bufferu; na HT/TC se půlka zdecimuje (součet
+// ADC_OVERSAMPLE vzorků >> (OS_SHIFT-ADC_EXTRA_BITS)) a proběhne Sampler::onTick().
+static const uint16_t SAMPLE_HZ      = 1000; // Gate::update() + RUN přechody
+#if MUX_ENABLE
+  static const uint8_t ADC_OVERSAMPLE = 4;   // 16 adres x 4 = 64 skenů/ms (~0.9 ms ADC)
+#else
+  static const uint8_t ADC_OVERSAMPLE = 16;  // vzorků na kanál a dávku (mocnina 2)
+#endif
+static const uint16_t ADC_SCANS      = (uint16_t)ADC_OVERSAMPLE * MUX_WAYS; // skenů na dávku
+// DUAL_ADC_ENABLE: sudé vstupy převádí ADC1, liché ADC2 ve stejném slotu; DMA čte
+// ADC1->DR po 32 bitech (ADC2<<16 | ADC1) => v _raw stejné pořadí vstupů jako s jedním ADC
+static const uint8_t  ADC_PARALLEL   = DUAL_ADC_ENABLE ? 2 : 1;
+static const uint8_t  ADC_SLOTS      = ADC_INPUTS / ADC_PARALLEL; // převodů na ADC za sken
+static_assert(ADC_INPUTS % ADC_PARALLEL == 0, "DUAL_ADC_ENABLE potrebuje sudy pocet vstupu");
+// první dávka DMA: AdcScan::begin() čeká 5 ms, setup() pak ještě ADC_START_MS;
+// bez ní by baseline vznikla z nulového bufferu => start se zastaví s chybou
+static const uint16_t ADC_START_MS   = 100;
+static const uint8_t  ADC_EXTRA_BITS = 2;    // 12 bit + 2 = 14 bit efektivně
+static const uint16_t BASE_UPDATE_HZ = 50;   // adaptace baseline (BASE_SHIFT platí pro tuto rychlost)
+static const uint8_t  SAMPLE_EVT_QUEUE = 32; // ISR -> loop fronta událostí (mocnina 2)
+
+// -------- Telemetrie (TeleCodec.h, host dekodér tools/teledec.cpp) --------
+// USB CDC build (env bluepill_f103c8_cdc): Serial = USB FS => každý vzorek.
+// Jinak Serial = USART1 115200 (~11 kB/s) a vzorek má ~9 B na 8 bran => jen každý 2.
+#if defined(USBCON) && defined(USBD_USE_CDC)
+  #define TELE_USB_CDC 1
+#else
+  #define TELE_USB_CDC 0
+#endif
+static const uint8_t  TELE_DECIM     = TELE_USB_CDC ? 1 : (GATE_COUNT <= 8 ? 2 : GATE_COUNT <= 16 ? 4 : 8);
+static const uint16_t TELE_KEY_EVERY = 500;  // vzorků telemetrie mezi KEY rámci
+static const uint8_t  TELE_FRAME_SAMPLES = 8; // vzorků na DELTA rámec
+static const uint8_t  TELE_QUEUE     = GATE_COUNT <= 8 ? 32 : 16; // ISR -> loop fronta vzorků (mocnina 2)
+static const uint16_t TELE_OUT_BUF   = 512;  // rámce čekající na volné místo v TX
+#define TELE_MAX_GATES GATE_COUNT            // TeleCodec.h: Sample jen pro vlastní brány
+
+// -------- Sběrnice řadičů (RS-485, Bus.h) --------
+// Víc BluePillů na jedné lince: master (BUS_ADDR 0) se ptá slave 1..BUS_MAX_SLAVES
+// a zobrazuje globální tabulku BUS_GATES bran (brána slave i = i*GATE_COUNT + g).
+// Linka = USART1 (PA9 TX, PA10 RX) + budič MAX3485, DE/RE na BUS_DE_PIN =>
+// konzole musí být na USB CDC (env bluepill_f103c8_bus) a piezo na PB8/PB9.
+// Adresa z BUS_ADDR, za běhu "bus addr <n>" (neukládá se).
+#ifndef BUS_ENABLE
+  #define BUS_ENABLE 0
+#endif
+#ifndef BUS_ADDR
+  #define BUS_ADDR 0
+#endif
+static const uint8_t  BUS_MAX_SLAVES = BUS_ENABLE ? 32 / GATE_COUNT - 1 : 0; // GateMask = 32 bran celkem
+static const uint8_t  BUS_GATES      = GATE_COUNT * (1 + BUS_MAX_SLAVES);
+static const uint32_t BUS_BAUD       = 500000;
+static const uint8_t  BUS_DE_PIN     = PA8;
+static const uint16_t BUS_REPLY_US   = 2000; // ticho od POLL / posledního bajtu => timeout
+static const uint8_t  BUS_OFFLINE_MISSES = 3;   // timeoutů za sebou => slave offline
+static const uint16_t BUS_OFFLINE_POLL_MS = 200; // offline slave se zkouší jen takhle často
+static const uint16_t BUS_LINK_MS    = 500;  // slave: bez POLL déle => vlastní ARM
+static const uint8_t  BUS_EVENT_QUEUE = 16;  // slave: nepotvrzené události
+static_assert(BUS_GATES <= 32, "globalni tabulka bran ma max. 32 (GateMask)");
+
+#if BUS_ENABLE && !USE_PIEZO_PORT_B
+  #error "BUS_ENABLE: PA8/PA9 patri sbernici (DE, USART1 TX), piezo na PB8/PB9"
+#endif
+#if BUS_ENABLE && IR_HW_STM32 && !TELE_USB_CDC
+  #error "BUS_ENABLE: USART1 patri sbernici, konzole musi byt na USB CDC"
+#endif
+
+// -------- Úsporný režim (Power.h) --------
+// loop() na začátku uspí jádro (WFI) do příštího přerušení: DMA dávka ADC,
+// SysTick (1 ms), EXTI tlačítek, UART/USB, I2C DMA. RUN bez ARM vzorkuje
+// SAMPLE_HZ/IDLE_RATE_DIV (TIM3 prescaler) – baseline a šum běží dál, jen
+// řidčeji; ARM, DIAG a zapnutá telemetrie = plná rychlost. OLED se v RUN
+// vypne po OLED_SLEEP_MS bez stisku, přerušené brány a alarmu.
+// Odhad proudu MCU ("power"): F103 @72 MHz, periferie zapnuté (datasheet typ.),
+// bez OLED a IR vysílačů.
+static const uint8_t  IDLE_RATE_DIV  = 4;
+static const uint32_t OLED_SLEEP_MS  = 60000;
+static const uint16_t POWER_RUN_MA   = 36;
+static const uint16_t POWER_SLEEP_MA = 14;
+static_assert(SAMPLE_HZ / BASE_UPDATE_HZ >= IDLE_RATE_DIV, "baseline se adaptuje nejvys kazdou davku");
+
+// SMPR kód: 0=1.5 .. 5=55.5, 6=71.5, 7=239.5 cyklů. Kvůli 45k pull-upům
+// min. 55.5 cyklů; 71.5 @ 12 MHz => 7 us/slot, 8 vstupů = 56 us/sken jedním ADC,
+// 28 us ve dvojicích (DUAL_ADC_ENABLE) při periodě 62.5 us (16 kHz);
+// s muxem 2 vstupy => 14 us / 7 us na sken (perioda 15.6 us při 64 kHz)
+#if LOCKIN_ENABLE && !DUAL_ADC_ENABLE
+  // lock-in: před skenem čekáme na ustálení po hraně nosné => kratší vzorkování
+  // (55.5 => 45 us/sken + LOCKIN_SETTLE_US < 62.5 us; s dual ADC se vejde i 71.5)
+  static const uint8_t  ADC_SMP_CODE = 5;
 #else
-  static const uint8_t PZ_A = PA8;
-  static const uint8_t PZ_B = PA9;
+  static const uint8_t  ADC_SMP_CODE = 6;
 #endif
 
-// IR brány (PA0..PA7)
-static const uint8_t  GATE_COUNT = 8;
-static const uint8_t  GATE_PINS[GATE_COUNT] = { PA0, PA1, PA2, PA3, PA4, PA5, PA6, PA7 };
+// -------- Lock-in (LOCKIN_ENABLE) --------
+// TIM3 CH3 přepíná vysílače na každém triggeru skenu => nosná SAMPLE_HZ*ADC_OVERSAMPLE/2
+// (8 kHz), sudé skeny = vysílač ON, liché = OFF. Sken startuje LOCKIN_SETTLE_US po hraně
+// (TRGO = OC4REF). Dávka = |sum(ON) - sum(OFF)| => amplituda paprsku, okolní světlo
+// (slunce, 100 Hz zářivky, drift) se odečte.
+static const uint8_t  LOCKIN_EMITTER_PIN = PB0;
+static const uint8_t  LOCKIN_SETTLE_US   = 10;
+
+#if MUX_ENABLE && LOCKIN_ENABLE
+  #error "MUX_ENABLE: TIM3 CH3 nastavuje adresu muxu, lock-in nosná nemá kanál"
+#endif
+
+// -------- Analog watchdog (okamžitý začátek přerušení) --------
+// Okno AWD = [0, max(base)+DELTA_ON] přes všechny brány (F103 má jen jedno okno;
+// DIFF_INVERT=0 => [min(base)-DELTA_ON, 4095]), v surových 12 bit. Kandidát z AWD ISR (DWT čas) se použije jako začátek
+// přerušení, když ho dávka potvrdí do AWD_MAX_AGE_US. V lock-in režimu vypnuto,
+// s muxem taky (vzorek kanálu patří podle skenu různým branám).
+#define AWD_ONSET_ENABLE (!LOCKIN_ENABLE && !MUX_ENABLE)
+static const uint16_t AWD_MARGIN_12 = 8;     // rezerva na šum jednoho vzorku
+static const uint16_t AWD_MAX_AGE_US = 4000;
 
 // -------- Detekce signálu (Gate) --------
-static const uint16_t DELTA_ON  = 45;
-static const uint16_t DELTA_OFF = 25;
+// Všechny prahy v LSB 14bitové (zdecimované) hodnoty, tj. 1/4 původního 12bit LSB.
+// Šum po průměrování 16 vzorků je ~4x menší => prahy níž než 4x původní.
+#if LOCKIN_ENABLE
+  // amplituda bez okolního světla => stačí mnohem menší okraje
+  static const uint16_t DELTA_ON  = 60;
+  static const uint16_t DELTA_OFF = 35;
+#else
+  static const uint16_t DELTA_ON  = 120;  // dřív 45 @ 12 bit
+  static const uint16_t DELTA_OFF = 70;   // dřív 25 @ 12 bit
+#endif
 static const uint8_t  BASE_SHIFT = 6;
+static const uint8_t  BASE_RETURN_SHIFT = 2; // návrat paprsku po přerušení (viz GateBank::update)
 static const uint16_t ARM_IGNORE_MS = 600;
 
 // -------- Počítání / uložení --------
-static const uint16_t SAVE_EVERY_MS = 1000;
+// Každý bod jde hned do backup registrů (přežijí reset), při poklesu napájení
+// ho PVD přerušení dopíše do flash => periodický zápis do flash stačí zřídka.
+static const uint32_t SAVE_EVERY_MS = 60000;
+
+// Flash layout (F103C8, stránky 1 KB), odshora:
+//   0x0800FC00  EEPROM emulace (jen migrace starých počtů)
+//   0x0800F000  žurnál počítadel (2 stránky)
+//   0x0800E800  kalibrace bran (2 stránky)
+//   0x0800D800  záznam přerušení (4 stránky, EventLog)
+// Firmware nesmí přerůst LOG_FLASH_BASE (board_upload.maximum_size).
+static const uint16_t FLASH_PAGE_BYTES   = 1024;
+static const uint32_t JOURNAL_FLASH_BASE = 0x0800F000;
+static const uint8_t  JOURNAL_PAGES      = 2;
+static const uint32_t CAL_FLASH_BASE     = 0x0800E800;
+static const uint8_t  CAL_PAGES          = 2;
+static const uint32_t LOG_FLASH_BASE     = 0x0800D800;
+static const uint8_t  LOG_PAGES          = 4;
+
+// záznam přerušení: RAM fronta -> flash po dávkách (ne uprostřed přerušení,
+// pokud se fronta neplní); ~84 záznamů na stránku, nejstarší stránka se přepíše
+static const uint8_t  LOG_RAM_RECORDS = 32;
+static const uint8_t  LOG_FLUSH_BATCH = 8;
+static const uint32_t LOG_FLUSH_MS    = 60000;
+
+// uložení ustálené baseline (kalibrace): nejvýš jednou za CAL_SAVE_EVERY_MS
+// a jen když některá baseline ujela o víc než CAL_BASE_DRIFT
+static const uint32_t CAL_SAVE_EVERY_MS = 1800000UL; // 30 min
+static const uint16_t CAL_BASE_DRIFT    = 40;
 
 // -------- RUN: Reset sekvence / okna --------
 static const uint16_t RESET_WINDOW_MS = 5000;
@@ -69,19 +277,55 @@ static const uint16_t BEEP2_ON_MS     = 70;
 static const uint16_t SIREN_LO_HZ = 800;
 static const uint16_t SIREN_HI_HZ = 2400;
 static const uint16_t SIREN_SWEEP_MS = 900;
+// stupeň 3: 0 = siréna, 1 = melodie MEL_ALARM (obojí syntéza v ISR časovače piezo)
+#ifndef ALARM_MELODY_ENABLE
+  #define ALARM_MELODY_ENABLE 0
+#endif
 
-// -------- DIAG: Geiger pípání podle síly diff --------
+// -------- DIAG: Geiger pípání podle úrovně (0.1 %, GateBank::level) --------
 static const uint16_t DIAG_BEEP_HZ = 2200;
 static const uint16_t DIAG_BEEP_MS = 22;
 
 static const uint16_t DIAG_PERIOD_SLOW_MS = 800;
 static const uint16_t DIAG_PERIOD_FAST_MS = 120;
 
-static const uint16_t DIAG_DIFF_GOOD  = 60;
-static const uint16_t DIAG_DIFF_PERF  = 120;
+static const uint16_t DIAG_LEVEL_ON   = 120;  // 12 %, bez kalibrace = dřívější DELTA_ON
+static const uint16_t DIAG_LEVEL_GOOD = 240;
+static const uint16_t DIAG_LEVEL_PERF = 480;
 
 // OLED
 static const uint8_t OLED_ADDR = 0x3C;
+static const uint32_t OLED_I2C_HZ = 400000; // I2C fast-mode (F103 max 400 kHz)
+static const uint16_t OLED_TX_TIMEOUT_MS = 50; // stránka ~3.5 ms; déle => přenos zahodit
+
+// RUN prah pro "porušení" (14 bit LSB, dřív 20 @ 12 bit)
+#if LOCKIN_ENABLE
+  static const uint16_t RUN_THR = 28;
+#else
+  static const uint16_t RUN_THR = 56;
+#endif
+
+// Šum v klidu (GateBank, pořád pro všechny brány): Welford průměr/rozptyl
+// signálu na straně přerušení nad idle, po oknech NOISE_WIN vzorků, jen
+// když brána není přerušená. RUN práh = průměr + RUN_K_SIGMA·sigma,
+// omezený na RUN_THR_MIN..RUN_THR_MAX; do prvního okna platí RUN_THR
+// (nebo sigma z uložené kalibrace).
+static const uint16_t NOISE_WIN   = 1024;
+static const uint8_t  RUN_K_SIGMA = 6;
+#if LOCKIN_ENABLE
+  static const uint16_t RUN_THR_MIN = 14;
+#else
+  static const uint16_t RUN_THR_MIN = 28;
+#endif
+static const uint16_t RUN_THR_MAX = 400;
 
-// RUN prah pro "porušení"
-static const uint16_t RUN_THR = 20;
+// Kalibrace ZERO/MAX (DIAG, držení T1): úroveň = (diff - ZERO) / (MAX - ZERO)
+// v 0.1 %, LEVEL_FULL = MAX, kladná na straně přerušení. Brána bez platné
+// dvojice bere ZERO = idle (nebo 0) a rozpětí CAL_SPAN_DEFAULT => 1 LSB = 0.1 %,
+// prahy vyjdou stejně jako v LSB. Kalibrovaná brána přeruší nad
+// RUN_THR_LEVEL (nejméně však nad prahem ze šumu) – stejné procento
+// u různě citlivých bran.
+static const int16_t  LEVEL_FULL       = 1000;
+static const uint16_t CAL_SPAN_DEFAULT = 1000; // 14 bit LSB
+static const uint16_t CAL_SPAN_MIN     = 32;   // menší rozpětí MAX-ZERO se nepřijme
+static const uint16_t RUN_THR_LEVEL    = 300;  // 30 %
@@ -3,7 +3,15 @@
 #include "Buzzer.h"
 #include "UiOled.h"
 #include "Storage.h"
-#include "Gate.h"
+#include "AdcScan.h"
+#include "Sampler.h"
+#include "Profiler.h"
+#include "Console.h"
+#include "Telemetry.h"
+#include "Rtc.h"
+#include "Bus.h"
+#include "Power.h"
+#include "Buttons.h"
 
 // ------------------------------------------------------------
 // Global
@@ -13,102 +21,51 @@ static uint32_t gateCounts[GATE_COUNT] = {0};
 static Buzzer  buzzer;
 static UiOled  ui;
 static Storage storage;
+static AdcScan adc;
+static Sampler sampler;
+static Console console;
+#if TELEMETRY_ENABLE
+static Telemetry telemetry;
+#endif
+#if BUS_ENABLE
+static Bus busNode;
+static uint32_t busCounts[BUS_GATES]; // master: globální tabulka pro UI
+#endif
 
 static AppMode mode = AppMode::Run;
-static uint8_t selectedGate = 0; // 0..GATE_COUNT-1
+static uint8_t selectedGate = 0; // 0..GATE_COUNT-1, GATE_COUNT = stránka PROF
 
-static Gate gates[GATE_COUNT];
+#if PROFILER_ENABLE
+static const uint8_t DIAG_PAGES = GATE_COUNT + 1;
+#else
+static const uint8_t DIAG_PAGES = GATE_COUNT;
+#endif
 
 // ------------------------------------------------------------
-// Debounce button (INPUT_PULLUP, active LOW)
+// Tlačítka (EXTI + gesta, Buttons.h)
 // ------------------------------------------------------------
-struct DebouncedButton {
-  uint8_t pin = 0;
-  uint8_t stable = HIGH;
-  uint8_t last = HIGH;
-  uint32_t lastChange = 0;
-
-  void begin(uint8_t p) {
-    pin = p;
-    pinMode(pin, INPUT_PULLUP);
-    stable = digitalRead(pin);
-    last = stable;
-    lastChange = millis();
-  }
-
-  uint8_t readStable(uint32_t now, uint32_t debounceMs = 25) {
-    uint8_t r = digitalRead(pin);
-    if (r != last) { last = r; lastChange = now; }
-    if (now - lastChange > debounceMs) stable = last;
-    return stable;
-  }
-
-  bool isPressed(uint32_t now) { return readStable(now) == LOW; }
-};
-
-static DebouncedButton btn1;
-static DebouncedButton btn2;
-
-// ------------------------------------------------------------
-// Press-sequence tracker (counts PRESS events inside window)
-// ------------------------------------------------------------
-struct PressTracker {
-  uint32_t windowStart = 0;
-  uint32_t lastPressMs = 0;
-  uint8_t  count = 0;
-
-  bool lastPressed = false;
-
-  bool updatePress(bool pressed, uint32_t nowMs) {
-    bool pressEdge = (pressed && !lastPressed);
-    lastPressed = pressed;
-    if (!pressEdge) return false;
-
-    if (count == 0) windowStart = nowMs;
-    count++;
-    lastPressMs = nowMs;
-    return true;
-  }
-
-  uint8_t finalizeIfReady(uint32_t nowMs, uint32_t windowMs, uint32_t gapEndMs) {
-    if (count == 0) return 0;
-
-    bool windowExpired = (nowMs - windowStart) > windowMs;
-    bool gapExpired    = (nowMs - lastPressMs) > gapEndMs;
-
-    if (windowExpired || gapExpired) {
-      uint8_t out = count;
-      count = 0;
-      windowStart = 0;
-      lastPressMs = 0;
-      return out;
-    }
-    return 0;
-  }
+static const uint8_t BTN1 = 0, BTN2 = 1;
+static const uint8_t BTN_PINS[Buttons::COUNT] = { BTN1_PIN, BTN2_PIN };
+static const BtnGestureCfg BTN_CFG[Buttons::COUNT] = {
+  // T1: 10x => RUN/DIAG, v DIAG držení = ZERO/MAX po CAL_HOLD_STAGE_MS
+  { TOGGLE_GAP_END_MS, DIAG_WINDOW_MS, 0, CAL_HOLD_STAGE_MS },
+  // T2: v DIAG 1x/3x, v RUN držení = reset počtů
+  { TOGGLE_GAP_END_MS, RESET_WINDOW_MS, BTN2_HOLD_RESET_MS, 0 },
 };
-
-static PressTracker btn1Seq;
-static PressTracker btn2Seq;
+static Buttons buttons;
+static bool armed = false;
 
 // ------------------------------------------------------------
-// DIAG metrics (per selected gate) based on getStrength()
+// DIAG metrics (per selected gate) based on GateBank::strength()
 // ------------------------------------------------------------
 static int16_t metNow = 0;
 static int16_t metPeak = 0;
 static uint32_t peakUntil = 0;
 
-static int16_t metMin = 32767;
-static int16_t metMax = -32768;
-static uint32_t noiseWindowStart = 0;
-
 static void resetDiagMetrics(uint32_t nowMs) {
   metNow = 0;
   metPeak = 0;
   peakUntil = nowMs;
-
-  metMin = 32767;
-  metMax = -32768;
-  noiseWindowStart = nowMs;
 }
 
 static void updateDiagMetrics(int16_t v, uint32_t nowMs) {
@@ -119,24 +76,6 @@ static void updateDiagMetrics(int16_t v, uint32_t nowMs) {
     metPeak = v;
     peakUntil = nowMs + 1500;
   }
-
-  // noise okno 600 ms
-  if (noiseWindowStart == 0) noiseWindowStart = nowMs;
-  if (v < metMin) metMin = v;
-  if (v > metMax) metMax = v;
-
-  if ((nowMs - noiseWindowStart) >= 600) {
-    noiseWindowStart = nowMs;
-    metMin = v;
-    metMax = v;
-  }
-}
-
-static int16_t getNoise() {
-  int32_t n = (int32_t)metMax - (int32_t)metMin;
-  if (n < 0) n = 0;
-  if (n > 32767) n = 32767;
-  return (int16_t)n;
 }
 
 // ------------------------------------------------------------
@@ -148,15 +87,12 @@ static void enterDiag() {
   selectedGate = 0;
   resetDiagMetrics(now);
 
-  // 3 krátké (spec)
-  buzzer.beepMs(2400, 60); delay(35);
-  buzzer.beepMs(2400, 60); delay(35);
-  buzzer.beepMs(2400, 60);
+  buzzer.play(PAT_ENTER_DIAG); // 3 krátké (spec)
 }
 
 static void enterRun() {
   mode = AppMode::Run;
-  buzzer.beepMs(1800, 240); // 1 dlouhé (spec)
+  buzzer.play(PAT_ENTER_RUN); // 1 dlouhé (spec)
 }
 
 static void toggleMode() {
@@ -164,218 +100,564 @@ static void toggleMode() {
   else enterRun();
 }
 
+// ------------------------------------------------------------
+// Start vzorkování: první dávka DMA je baseline všech bran
+// ------------------------------------------------------------
+static void waitFirstBatch() {
+  const uint32_t t0 = millis();
+  while (adc.batches() == 0) {
+    if (millis() - t0 <= ADC_START_MS) continue;
+
+    // ADC/DMA neběží => nepočítat nic (baseline z nul = všechny brány "rozbité"),
+    // hlásit chybu, dokud někdo nevypne napájení
+    Serial.begin(115200);
+    ui.showFault("ADC/DMA nebezi");
+    uint32_t lastMsg = 0;
+    for (;;) {
+      const uint32_t now = millis();
+      if (!buzzer.isPlaying()) buzzer.play(PAT_FAULT);
+      buzzer.service(now);
+      if (now - lastMsg >= 1000) { lastMsg = now; Serial.println("CHYBA: ADC/DMA bez prvni davky"); }
+    }
+  }
+}
+
+// ------------------------------------------------------------
+// Kalibrace bran ve flash (idle/zero/max + baseline)
+// ------------------------------------------------------------
+static uint16_t calSavedBase[GATE_COUNT] = {0};
+static uint32_t calLastCheckMs = 0;
+
+static void loadCalibration() {
+  GateCal cal[GATE_COUNT];
+  if (!storage.loadCalibration(cal, GATE_COUNT)) return;
+
+  // baseline hned z flash => detekce funguje od prvního vzorku
+  noInterrupts();
+  for (uint8_t g = 0; g < GATE_COUNT; g++) sampler.bank().importCal(g, cal[g]);
+  interrupts();
+  for (uint8_t g = 0; g < GATE_COUNT; g++) calSavedBase[g] = cal[g].base;
+}
+
+static void saveCalibration() {
+  GateCal cal[GATE_COUNT];
+  noInterrupts();
+  for (uint8_t g = 0; g < GATE_COUNT; g++) cal[g] = sampler.bank().exportCal(g);
+  interrupts();
+  storage.saveCalibration(cal, GATE_COUNT);
+  for (uint8_t g = 0; g < GATE_COUNT; g++) calSavedBase[g] = cal[g].base;
+}
+
+// baseline se pomalu posouvá (teplota, stárnutí LED) – uložit jen při
+// znatelném posunu a jen když žádná brána není přerušená
+static void saveCalibrationIfDrifted(uint32_t nowMs) {
+  if ((nowMs - calLastCheckMs) < CAL_SAVE_EVERY_MS) return;
+  calLastCheckMs = nowMs;
+
+  const GateBank& bank = sampler.bank();
+  bool drift = false;
+  for (uint8_t g = 0; g < GATE_COUNT; g++) {
+    if (!bank.isSettled(g)) return;
+    int32_t d = (int32_t)bank.base(g) - (int32_t)calSavedBase[g];
+    if (d < 0) d = -d;
+    if (d > CAL_BASE_DRIFT) drift = true;
+  }
+  if (drift) saveCalibration();
+}
+
+// ------------------------------------------------------------
+// Sériová konzole
+// ------------------------------------------------------------
+static void cmdProf(Print& out, const char* args) {
+  if (strcmp(args, "reset") == 0) { profiler.reset(); out.println("ok"); return; }
+  profiler.dump(out);
+}
+
+// šum v klidu a RUN práh každé brány (GateBank)
+static void cmdNoise(Print& out, const char*) {
+  const GateBank& bank = sampler.bank();
+  for (uint8_t g = 0; g < GATE_COUNT; g++) {
+    char line[80];
+    const uint16_t sq4 = bank.noiseSigmaQ4(g);
+    const int16_t lt = bank.levelThr(g);
+    snprintf(line, sizeof(line), "B%u mean %d sigma %u.%02u pp %u thr %u = %d.%d%%%s",
+             (unsigned)(g + 1), (int)bank.noiseMean(g), (unsigned)(sq4 / 16),
+             (unsigned)((sq4 % 16) * 100 / 16), (unsigned)bank.noisePp(g), (unsigned)bank.runThr(g),
+             (int)(lt / 10), (int)(lt % 10), bank.isCalibrated(g) ? " cal" : "");
+    out.println(line);
+  }
+}
+
+static void printBreak(Print& out, uint32_t i, const BreakRecord& r) {
+  char t[24], line[80];
+  Rtc::format(t, sizeof(t), r.t);
+  snprintf(line, sizeof(line), "#%lu %s B%u %lums st%u pk%d%s",
+           (unsigned long)i, t, (unsigned)(r.gate + 1), (unsigned long)r.durMs,
+           (unsigned)r.stage, (int)r.peak, r.durMs >= COUNT_AT_MS ? " +1" : "");
+  out.println(line);
+}
+
+// log = posledních LOG_PAGE_LINES, log <i> = od indexu i, log clear
+static void cmdLog(Print& out, const char* args) {
+  static const uint8_t LOG_PAGE_LINES = 10;
+  const EventLog& log = storage.log();
+
+  if (strcmp(args, "clear") == 0) { storage.clearLog(); out.println("ok"); return; }
+
+  const uint32_t n = log.count();
+  uint32_t from = n > LOG_PAGE_LINES ? n - LOG_PAGE_LINES : 0;
+  if (*args) from = strtoul(args, nullptr, 10);
+
+  for (uint32_t i = from; i < n && i < from + LOG_PAGE_LINES; i++) {
+    BreakRecord r;
+    if (log.get(i, r)) printBreak(out, i, r);
+    else { out.print("#"); out.print(i); out.println(" -"); }
+  }
+  out.print("zaznamu ");
+  out.print(n);
+  out.print(", v RAM ");
+  out.print((unsigned)log.pending());
+  out.print(", ztraceno ");
+  out.println(log.lost());
+}
+
+static void cmdTime(Print& out, const char* args) {
+  if (*args) rtc.set(strtoul(args, nullptr, 10));
+  char t[24];
+  Rtc::format(t, sizeof(t), rtc.now());
+  out.println(t);
+}
+
+static void cmdPower(Print& out, const char* args) {
+  if (strcmp(args, "reset") == 0) { power.reset(); out.println("ok"); return; }
+  power.dump(out);
+}
+
+#if TELEMETRY_ENABLE
+static void teleTap(const GateBank& bank) { telemetry.onSample(bank); }
+
+static void cmdTele(Print& out, const char* args) {
+  if (strcmp(args, "on") == 0) { telemetry.setEnabled(true); return; }
+  if (strcmp(args, "off") == 0) { telemetry.setEnabled(false); out.println("ok"); return; }
+  out.print(telemetry.enabled() ? "on" : "off");
+  out.print(" decim=");
+  out.print((unsigned)TELE_DECIM);
+  out.print(" frames=");
+  out.print(telemetry.frames());
+  out.print(" samples=");
+  out.print(telemetry.samples());
+  out.print(" dropped=");
+  out.println(telemetry.dropped());
+}
+#endif
+
+#if BUS_ENABLE
+// master: přerušení na slave do vlastního záznamu (brána v globálním číslování)
+static void onBusEvent(uint8_t node, const bus::Event& e, uint32_t latencyUs) {
+  if (e.kind != bus::EV_BREAK_END) return;
+  BreakRecord r;
+  r.t = rtc.now() - (latencyUs / 1000UL + e.arg) / 1000UL;
+  r.durMs = e.arg;
+  r.peak = 0;
+  r.gate = (uint8_t)(node * GATE_COUNT + e.gate);
+  r.stage = e.stage;
+  storage.logBreak(r);
+}
+
+// bus = stav, bus addr <n> (0 = master), bus reset = statistiky
+static void cmdBus(Print& out, const char* args) {
+  if (strncmp(args, "addr ", 5) == 0) { busNode.setAddr((uint8_t)atoi(args + 5)); out.println("ok"); return; }
+  if (strcmp(args, "reset") == 0) { busNode.resetStats(); out.println("ok"); return; }
+
+  char line[96];
+  if (!busNode.isMaster()) {
+    snprintf(line, sizeof(line), "slave %u: poll %lu, spojeni %s, ARM %u, ztraceno %lu, crc %lu",
+             (unsigned)busNode.addr(), (unsigned long)busNode.polls(), busNode.linked() ? "ok" : "ne",
+             (unsigned)busNode.masterArmed(), (unsigned long)busNode.lostEvents(), (unsigned long)busNode.crcErrors());
+    out.println(line);
+    return;
+  }
+  snprintf(line, sizeof(line), "master: online %u/%u, crc %lu",
+           (unsigned)busNode.onlineCount(), (unsigned)BUS_MAX_SLAVES, (unsigned long)busNode.crcErrors());
+  out.println(line);
+  for (uint8_t i = 1; i <= BUS_MAX_SLAVES; i++) {
+    const Bus::Node& n = busNode.node(i);
+    snprintf(line, sizeof(line), "S%u %s poll %lu rep %lu tmo %lu lat %lu/%lu us",
+             (unsigned)i, n.online ? "on " : "off", (unsigned long)n.polls, (unsigned long)n.reports,
+             (unsigned long)n.timeouts, (unsigned long)n.latLastUs, (unsigned long)n.latMaxUs);
+    out.println(line);
+    if (!n.seen) continue;
+    out.print(" ");
+    for (uint8_t g = 0; g < GATE_COUNT; g++) {
+      out.print(" B");
+      out.print((unsigned)(i * GATE_COUNT + g + 1));
+      out.print("=");
+      out.print(n.counts[g]);
+    }
+    out.println();
+  }
+}
+#endif
+
 // ------------------------------------------------------------
 // Setup
 // ------------------------------------------------------------
 void setup() {
-  for (uint8_t i = 0; i < GATE_COUNT; i++) pinMode(GATE_PINS[i], INPUT_ANALOG);
+  for (uint8_t i = 0; i < ADC_INPUTS; i++) pinMode(ADC_PINS[i], INPUT_ANALOG);
 
-  btn1.begin(BTN1_PIN);
-  btn2.begin(BTN2_PIN);
+  buttons.begin(BTN_PINS, BTN_CFG);
 
   buzzer.begin(PZ_A, PZ_B);
+  rtc.begin();
 
-  // Boot beep 2x (ověření)
-  buzzer.beepMs(2000, 60); delay(60);
-  buzzer.beepMs(2000, 60);
+  // Boot beep 2x (ověření) – dohraje se v loop()
+  buzzer.play(PAT_BOOT);
 
   storage.begin();
   storage.loadCounts(gateCounts, GATE_COUNT);
+  storage.enablePowerFailFlush(gateCounts, GATE_COUNT);
 
   ui.begin();
 
-  for (uint8_t i = 0; i < GATE_COUNT; i++) gates[i].begin(GATE_PINS[i]);
+  if (!adc.begin()) waitFirstBatch();
+  sampler.begin(adc);
+  loadCalibration();
+  power.begin();
+
+  Serial.begin(115200);
+  console.begin(Serial);
+  console.add("prof", cmdProf, "casy loop/ISR [us], histogramy; prof reset");
+  console.add("noise", cmdNoise, "sum v klidu a RUN prah bran [LSB 14 bit, %]");
+  console.add("log", cmdLog, "zaznam preruseni; log <od>, log clear");
+  console.add("time", cmdTime, "cas RTC; time <unix> nastavi (UTC)");
+  console.add("power", cmdPower, "aktivni/spanek a odhad proudu po rezimech; power reset");
+#if TELEMETRY_ENABLE
+  telemetry.begin(Serial);
+  sampler.setTap(teleTap);
+  console.add("tele", cmdTele, "binarni stream vzorku (tools/teledec); tele on|off");
+#endif
+#if BUS_ENABLE
+  Serial1.begin(BUS_BAUD);
+  busNode.begin(Serial1, BUS_DE_PIN, BUS_ADDR);
+  busNode.setCounts(gateCounts);
+  busNode.onEvent(onBusEvent);
+  console.add("bus", cmdBus, "sbernice radicu; bus addr <n> (0=master), bus reset");
+#endif
 }
 
 // ------------------------------------------------------------
-// RUN state per gate
+// Události ze vzorkovače (ISR -> loop)
 // ------------------------------------------------------------
-struct GateRunState {
-  bool interrupted = false;
-  uint32_t sinceMs = 0;
-  bool counted = false;
-};
-static GateRunState runState[GATE_COUNT];
-
-static void resetRunStates() {
-  for (uint8_t i = 0; i < GATE_COUNT; i++) {
-    runState[i].interrupted = false;
-    runState[i].sinceMs = 0;
-    runState[i].counted = false;
+static void drainSamplerEvents() {
+  PROF_SCOPE(Prof::Events);
+  SampleEvent e;
+  while (sampler.pollEvent(e)) {
+    switch (e.type) {
+      case SampleEvt::BreakEnd: {
+#if BUS_ENABLE
+        busNode.noteEvent(bus::EV_BREAK_END, e.gate, e.stage, micros() - (sampler.nowUs() - e.tUs), e.arg);
+#endif
+        BreakRecord r;
+        // začátek = konec (čas vzorkovače) - délka, přepočteno na RTC
+        r.t = rtc.now() - (sampler.nowMs() - e.tMs + e.arg) / 1000UL;
+        r.durMs = e.arg;
+        r.peak = e.peak;
+        r.gate = e.gate;
+        r.stage = e.stage;
+        storage.logBreak(r);
+        break;
+      }
+      case SampleEvt::BreakStart:
+#if PROFILER_ENABLE
+        // začátek přerušení (AWD) -> tady; arg = zpoždění detekce v ISR
+        profiler.addLatencyUs(e.arg + (sampler.nowUs() - e.tUs));
+#endif
+#if BUS_ENABLE
+        busNode.noteEvent(bus::EV_BREAK_START, e.gate, 0, micros() - (sampler.nowUs() - e.tUs) - e.arg, 0);
+#endif
+        break;
+      case SampleEvt::Counted:
+        gateCounts[e.gate]++;
+        storage.noteCount(gateCounts, e.gate);
+#if BUS_ENABLE
+        busNode.noteCount(e.gate);
+#endif
+        break;
+      default:
+        break;
+    }
   }
 }
 
-// ------------------------------------------------------------
-// Loop
-// ------------------------------------------------------------
-void loop() {
-  uint32_t now = millis();
+static void drawUi(const UiState& s) {
+  PROF_SCOPE(Prof::Ui);
+#if POWER_SAVE_ENABLE
+  // OLED zhasnout po nečinnosti v RUN; přerušená brána nebo alarm = aktivita
+  const uint32_t now = millis();
+  if (s.mode == AppMode::Diag || s.broken || s.stage) power.activity(now);
+  ui.setAwake(!power.inactive(now));
+#endif
+#if BUS_ENABLE
+  if (busNode.isMaster()) {
+    const uint8_t n = busNode.globalCounts(gateCounts, busCounts);
+    ui.draw(s, busCounts, n);
+    return;
+  }
+#endif
+  ui.draw(s, gateCounts, GATE_COUNT);
+}
 
-  // --- buttons stable ---
-  bool b1 = btn1.isPressed(now);
-  bool b2 = btn2.isPressed(now);
+// přerušené brány a stupeň alarmu; master sběrnice i za slave
+static GateMask brokenMask() {
+  GateMask m = sampler.bank().brokenMask();
+#if BUS_ENABLE
+  if (busNode.isMaster()) m = busNode.globalBroken(m);
+#endif
+  return m;
+}
 
-  // --- sequence counts ---
-  btn1Seq.updatePress(b1, now);
-  btn2Seq.updatePress(b2, now);
+static uint8_t alarmStage() {
+  uint8_t st = sampler.worstStage();
+#if BUS_ENABLE
+  if (busNode.isMaster()) st = busNode.globalStage(st);
+#endif
+  return st;
+}
 
-  // BTN1: 10x press => toggle RUN/DIAG
-  uint8_t b1Done = btn1Seq.finalizeIfReady(now, DIAG_WINDOW_MS, TOGGLE_GAP_END_MS);
-  if (b1Done >= DIAG_TOGGLES) toggleMode();
+static void onButton(const BtnEvent& e, uint32_t now) {
+  if (e.button == BTN1) {
+    switch (e.type) {
+      case BtnEvt::Press:
+        // RUN: stisk = ARM ON (klik) / OFF (ticho)
+        if (mode != AppMode::Run) break;
+        armed = !armed;
+        if (armed) buzzer.click();
+        else buzzer.off();
+        break;
+      case BtnEvt::Sequence:
+        if (e.arg >= DIAG_TOGGLES) toggleMode();
+        break;
+      case BtnEvt::HoldStage:
+        // DIAG: držení => ZERO, MAX, ZERO, ... vybrané brány
+        if (mode != AppMode::Diag || selectedGate >= GATE_COUNT) break;
+        // _ofs/_scaleQ15/_thrLvl čte ISR vzorkovače => měnit atomicky
+        noInterrupts();
+        if (e.arg & 1) sampler.bank().setZero(selectedGate);
+        else sampler.bank().setMax(selectedGate);
+        interrupts();
+        saveCalibration();
+        buzzer.play((e.arg & 1) ? PAT_ZERO_SET : PAT_MAX_SET);
+        break;
+      default:
+        break;
+    }
+    return;
+  }
 
-  // BTN2: in DIAG => 1x next gate, 3x setIdle(selected)
-  if (mode == AppMode::Diag) {
-    uint8_t b2Done = btn2Seq.finalizeIfReady(now, RESET_WINDOW_MS, TOGGLE_GAP_END_MS);
-    if (b2Done == 1) {
-      selectedGate = (uint8_t)((selectedGate + 1) % GATE_COUNT);
+  // BTN2: in DIAG => 1x next gate (za poslední PROF), 3x setIdle(selected) / PROF reset
+  if (e.type == BtnEvt::Sequence && mode == AppMode::Diag) {
+    if (e.arg == 1) {
+      selectedGate = (uint8_t)((selectedGate + 1) % DIAG_PAGES);
       buzzer.click();
       resetDiagMetrics(now);
-    } else if (b2Done == 3) {
-      gates[selectedGate].setIdle();
+    } else if (e.arg == RESET_TOGGLES && selectedGate >= GATE_COUNT) {
+      profiler.reset();
+      buzzer.play(PAT_RESET_DONE);
+    } else if (e.arg == RESET_TOGGLES) {
+      noInterrupts();
+      sampler.bank().setIdle(selectedGate);
+      interrupts();
+      saveCalibration();
       resetDiagMetrics(now);
-      buzzer.beepMs(2000, 70); delay(60);
-      buzzer.beepMs(2000, 70);
+      buzzer.play(PAT_IDLE_SET);
     }
   }
 
   // BTN2: long press in RUN => reset counts
-  static bool b2WasPressed = false;
-  static uint32_t b2PressSince = 0;
-  static bool b2LongDone = false;
-
-  if (b2 && !b2WasPressed) { b2WasPressed = true; b2PressSince = now; b2LongDone = false; }
-  else if (!b2 && b2WasPressed) { b2WasPressed = false; b2PressSince = 0; b2LongDone = false; }
-
-  if (mode == AppMode::Run && b2WasPressed && !b2LongDone && (now - b2PressSince) >= BTN2_HOLD_RESET_MS) {
-    b2LongDone = true;
+  if (e.type == BtnEvt::Hold && mode == AppMode::Run) {
     for (uint8_t i = 0; i < GATE_COUNT; i++) gateCounts[i] = 0;
     storage.saveCountsIfNeeded(gateCounts, GATE_COUNT, true);
-
-    buzzer.beepMs(2000, 80); delay(80);
-    buzzer.beepMs(2000, 80); delay(80);
-    buzzer.beepMs(2000, 80);
+#if BUS_ENABLE
+    busNode.requestFull(); // jen vlastní počty; slave nuluje každý u sebe
+#endif
+    buzzer.play(PAT_RESET_DONE);
   }
+}
 
-  // BTN1 short press => toggle ARM in RUN
-  static bool armed = false;
-  static bool b1WasPressed = false;
-  static uint32_t ignoreUntil = 0;
-
-  if (mode == AppMode::Run) {
-    if (b1 && !b1WasPressed) {
-      b1WasPressed = true;
-      armed = !armed;
-
-      if (armed) { ignoreUntil = now + ARM_IGNORE_MS; buzzer.click(); } // ARM ON = klik
-      else { buzzer.off(); resetRunStates(); }                         // ARM OFF = ticho
-    } else if (!b1 && b1WasPressed) b1WasPressed = false;
-  } else {
-    armed = false;
-    b1WasPressed = b1;
+// ------------------------------------------------------------
+// Loop
+// ------------------------------------------------------------
+void loop() {
+  // minulý průchod hotový => spát do příštího přerušení (dávka ADC, SysTick, EXTI, UART)
+  power.idle(!sampler.hasEvents());
+
+  uint32_t now = millis();
+#if PROFILER_ENABLE
+  profiler.loopMark();
+#endif
+
+  { PROF_SCOPE(Prof::Sound); buzzer.service(now); }
+  console.poll();
+#if TELEMETRY_ENABLE
+  { PROF_SCOPE(Prof::Tele); telemetry.service(); }
+#endif
+#if BUS_ENABLE
+  { PROF_SCOPE(Prof::Bus); busNode.service(); }
+#endif
+
+  PROF_START(tBtn);
+
+  // gesta podle časů hran z EXTI – nezáleží na tom, jak dlouho loop() stál
+  buttons.service();
+  BtnEvent be;
+  while (buttons.pollEvent(be)) {
+    power.activity(now);
+    onButton(be, now);
   }
+  if (mode != AppMode::Run) armed = false;
+
+#if BUS_ENABLE
+  // slave drží ARM mastera, dokud ho master obsluhuje
+  if (mode == AppMode::Run && busNode.linked() && armed != busNode.masterArmed()) {
+    armed = busNode.masterArmed();
+    if (armed) buzzer.click();
+    else buzzer.off();
+  }
+  busNode.setArmed(armed);
+#endif
+
+  PROF_STOP(Prof::Buttons, tBtn);
+
+  // vzorkovač hlídá brány sám (ISR), sem jen ARM stav a události
+  sampler.setArmed(armed);
+  const PowerMode pm = mode == AppMode::Diag ? PowerMode::Diag : armed ? PowerMode::Armed : PowerMode::Idle;
+  power.setMode(pm);
+  // bez ARM stačí řidší vzorky (baseline, šum); telemetrie chce plnou rychlost
+  bool slow = POWER_SAVE_ENABLE && pm == PowerMode::Idle;
+#if TELEMETRY_ENABLE
+  slow = slow && !telemetry.enabled();
+#endif
+  sampler.setRateDiv(slow ? IDLE_RATE_DIV : 1);
+  drainSamplerEvents();
+#if BUS_ENABLE
+  busNode.setLocal(sampler.bank().brokenMask(), armed ? sampler.worstStage() : 0);
+#endif
+  { PROF_SCOPE(Prof::Storage); storage.flushLogIfNeeded(now, sampler.bank().brokenMask() == 0); }
+
+  // DIAG: stránka PROF (časy úseků loop()/ISR)
+  if (mode == AppMode::Diag && selectedGate >= GATE_COUNT) {
+    buzzer.off();
 
-  // Update gates
-  for (uint8_t i = 0; i < GATE_COUNT; i++) gates[i].update();
+    UiState s;
+    s.mode = AppMode::Diag;
+    s.selectedGate = selectedGate;
+    s.profPage = true;
+    s.profGen = now / 500; // čísla překreslit 2x za s
+
+    static uint32_t lastDraw = 0;
+    if (now - lastDraw >= 120) { lastDraw = now; drawUi(s); }
+    return;
+  }
 
   // DIAG: selected gate meter + geiger
   if (mode == AppMode::Diag) {
-    int16_t strength = gates[selectedGate].getStrength();
-    updateDiagMetrics(strength, now);
+    const GateBank& bank = sampler.bank();
+    updateDiagMetrics(bank.strength(selectedGate), now);
 
-    // zvuk DIAG nechávám na strength (zatím), spec percent doděláme později
-    buzzer.tickDiagMeter(now, strength);
+    // zvuk podle úrovně (%) => po kalibraci ZERO/MAX stejný u všech bran
+    { PROF_SCOPE(Prof::Sound); buzzer.tickDiagMeter(now, bank.level(selectedGate)); }
 
     UiState s;
     s.mode = AppMode::Diag;
     s.selectedGate = selectedGate;
     s.diff = metNow;
     s.diffPeak = metPeak;
-    s.noise = getNoise();
+    s.level = bank.level(selectedGate);
+    s.levelThr = bank.levelThr(selectedGate);
+    s.calibrated = bank.isCalibrated(selectedGate);
+    // šum (špička-špička v klidu) počítá GateBank pořád pro všechny brány
+    s.noise = (int16_t)sampler.bank().noisePp(selectedGate);
 
     static uint32_t lastDraw = 0;
-    if (now - lastDraw >= 120) { lastDraw = now; ui.draw(s, gateCounts, GATE_COUNT); }
+    if (now - lastDraw >= 120) { lastDraw = now; drawUi(s); }
     return;
   }
 
-  // RUN: evaluate all gates, pick worst stage
+  // RUN: stav spočítal vzorkovač, tady jen zvuk + UI
   UiState s;
   s.mode = AppMode::Run;
   s.armed = armed;
 
-  bool inIgnore = (armed && now < ignoreUntil);
+  bool inIgnore = sampler.inIgnore();
   s.inIgnore = inIgnore;
 
   if (!armed || inIgnore) {
     buzzer.off();
-    s.gate1Signal = !gates[0].isBroken(RUN_THR);
+    s.broken = brokenMask();
     s.stage = 0;
     s.interruptedMs = 0;
 
     static uint32_t lastDraw = 0;
-    if (now - lastDraw >= 120) { lastDraw = now; ui.draw(s, gateCounts, GATE_COUNT); }
+    if (now - lastDraw >= 120) { lastDraw = now; drawUi(s); }
+#if !BUS_ENABLE && !POWER_SAVE_ENABLE
+    // se sběrnicí ne: slave musí odpovědět do BUS_REPLY_US; s úsporou spí WFI
     delay(6);
+#endif
     return;
   }
 
-  uint8_t worstStage = 0;
-  uint32_t longestInterruptedMs = 0;
-
-  for (uint8_t i = 0; i < GATE_COUNT; i++) {
-    bool broken = gates[i].isBroken(RUN_THR);
-
-    if (broken) {
-      if (!runState[i].interrupted) {
-        runState[i].interrupted = true;
-        runState[i].sinceMs = now;
-        runState[i].counted = false;
-      }
-    } else {
-      runState[i].interrupted = false;
-      runState[i].counted = false;
-      runState[i].sinceMs = 0;
-    }
-
-    if (runState[i].interrupted) {
-      uint32_t ms = now - runState[i].sinceMs;
-      if (ms > longestInterruptedMs) longestInterruptedMs = ms;
-
-      uint8_t stage = 0;
-      // SPEC: 0..1s ticho, 1..2s rychlé pípání, 2..3s táhlý tón, 3s+ alarm
-      if      (ms < STAGE1_MS) stage = 0;
-      else if (ms < STAGE2_MS) stage = 1;
-      else if (ms < STAGE3_MS) stage = 2;
-      else                     stage = 3;
-
-      if (stage > worstStage) worstStage = stage;
-
-      if (!runState[i].counted && ms >= COUNT_AT_MS) {
-        gateCounts[i]++;
-        runState[i].counted = true;
-      }
-    }
-  }
+  uint8_t worstStage = alarmStage();
 
   SoundMode sm = SoundMode::Off;
   // Mapujeme na existující režimy Buzzeru:
   //  - spec stage1 (1..2s) = rychlé pípání => GateInterruptedStage3
   //  - spec stage2 (2..3s) = táhlý tón     => GateInterruptedStage1
-  //  - spec stage3 (3s+)   = siréna        => GateInterruptedSiren
+  //  - spec stage3 (3s+)   = siréna        => GateInterruptedSiren (nebo melodie)
   switch (worstStage) {
     default: sm = SoundMode::Off; break;
     case 0:  sm = SoundMode::Off; break;
     case 1:  sm = SoundMode::GateInterruptedStage3; break;
     case 2:  sm = SoundMode::GateInterruptedStage1; break;
+#if ALARM_MELODY_ENABLE
+    case 3:  sm = SoundMode::GateInterruptedMelody; break;
+#else
     case 3:  sm = SoundMode::GateInterruptedSiren;  break;
+#endif
   }
 
-  // UI má jen gate1Signal => mapuju na B1
-  s.gate1Signal = !gates[0].isBroken(RUN_THR);
+  s.broken = brokenMask();
   s.stage = worstStage;
-  s.interruptedMs = longestInterruptedMs;
+  s.interruptedMs = sampler.longestInterruptedMs();
 
-  buzzer.tick(sm, now);
-  storage.saveCountsIfNeeded(gateCounts, GATE_COUNT, false);
+  { PROF_SCOPE(Prof::Sound); buzzer.tick(sm, now); }
+  {
+    PROF_SCOPE(Prof::Storage);
+    storage.saveCountsIfNeeded(gateCounts, GATE_COUNT, false);
+    saveCalibrationIfDrifted(now);
+  }
 
   static uint32_t lastDraw = 0;
-  if (now - lastDraw >= 120) { lastDraw = now; ui.draw(s, gateCounts, GATE_COUNT); }
+  if (now - lastDraw >= 120) { lastDraw = now; drawUi(s); }
+}
+
+#if !IR_HW_STM32
+// ------------------------------------------------------------
+// Host simulace (sim/Replay.cpp): přístup ke stavu aplikace
+// ------------------------------------------------------------
+AdcScan& simAdc() { return adc; }
+const Sampler& simSampler() { return sampler; }
+uint32_t simGateCount(uint8_t g) { return g < GATE_COUNT ? gateCounts[g] : 0; }
+uint8_t simMode() { return (uint8_t)mode; }
+uint16_t simBuzzerHz() { return buzzer.currentHz(); }
+void simBuzzerAdvance(uint32_t us) { buzzer.simAdvance(us); }
+uint32_t simLogCount() { return storage.log().count(); }
+#if BUS_ENABLE
+uint32_t simBusCount(uint8_t g) {
+  busNode.globalCounts(gateCounts, busCounts);
+  return g < BUS_GATES ? busCounts[g] : 0;
 }
+uint8_t simBusStage() { return alarmStage(); }
+uint8_t simBusOnline() { return busNode.onlineCount(); }
+uint32_t simBusLatMaxUs() { return busNode.latMaxUs(); }
+#endif
+#endif
@@ -0,0 +1,72 @@
+// Dekodér binární telemetrie bran (src/TeleCodec.h) -> CSV.
+//   g++ -O2 -std=gnu++14 -I src -o teledec tools/teledec.cpp
+//   teledec [--check] [zaznam.bin] > vzorky.csv     (bez souboru čte stdin)
+// Záznam: linka po "tele on" (např. stty -F /dev/ttyACM0 raw; cat /dev/ttyACM0 > z.bin),
+// nebo ze simulace: program sim/traces/tele.trc --serial-out z.bin
+// CSV: index, t_ms, pak za bránu raw, base, diff. Souhrn na stderr.
+// --check: bez CSV; návratový kód 1 při chybě CRC, díře nebo prázdném záznamu.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "TeleCodec.h"
+
+struct Out {
+  const tele::Decoder* dec;
+  FILE* csv;
+  bool header;
+  unsigned sampleHz;
+};
+
+static void onSample(void* ctx, uint32_t index, const tele::Sample& s) {
+  Out& o = *(Out*)ctx;
+  if (!o.csv) return;
+  const uint8_t gates = o.dec->gates();
+  if (!o.header) {
+    o.header = true;
+    fprintf(o.csv, "index,t_ms");
+    for (uint8_t g = 1; g <= gates; g++) fprintf(o.csv, ",raw%u,base%u,diff%u", g, g, g);
+    fputc('\n', o.csv);
+  }
+  fprintf(o.csv, "%lu,%.3f", (unsigned long)index, index * 1000.0 / o.sampleHz);
+  const bool inv = o.dec->flags() & tele::FLAG_DIFF_INVERT;
+  for (uint8_t g = 0; g < gates; g++) {
+    const int d = inv ? (int)s.raw[g] - (int)s.base[g] : (int)s.base[g] - (int)s.raw[g];
+    fprintf(o.csv, ",%u,%u,%d", s.raw[g], s.base[g], d);
+  }
+  fputc('\n', o.csv);
+}
+
+int main(int argc, char** argv) {
+  bool check = false;
+  const char* path = nullptr;
+  unsigned sampleHz = 1000; // SAMPLE_HZ v config.h
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--check")) check = true;
+    else if (!strcmp(argv[i], "--hz") && i + 1 < argc) sampleHz = (unsigned)atoi(argv[++i]);
+    else if (argv[i][0] != '-') path = argv[i];
+    else { fprintf(stderr, "pouziti: %s [--check] [--hz N] [zaznam.bin]\n", argv[0]); return 2; }
+  }
+
+  FILE* in = path ? fopen(path, "rb") : stdin;
+  if (!in) { perror(path); return 2; }
+
+  Out o = { nullptr, check ? nullptr : stdout, false, sampleHz ? sampleHz : 1000 };
+  tele::Decoder dec(onSample, &o);
+  o.dec = &dec;
+
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    for (size_t i = 0; i < n; i++) dec.push(buf[i]);
+  }
+  if (in != stdin) fclose(in);
+
+  const tele::Decoder::Stats& st = dec.stats();
+  fprintf(stderr, "ramce %lu, vzorky %lu, bran %u, decim %u, CRC chyb %lu, der %lu, bajtu mimo ramce %lu\n",
+          (unsigned long)st.frames, (unsigned long)st.samples, dec.gates(), dec.decim(),
+          (unsigned long)st.crcErrors, (unsigned long)st.gaps, (unsigned long)st.skipped);
+
+  if (check && (st.samples == 0 || st.crcErrors || st.gaps)) return 1;
+  return 0;
+}